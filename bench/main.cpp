@@ -0,0 +1,303 @@
+#include "utils.h"
+#include "globals.h"
+#include "udpbench.h"
+#include "tcpbench.h"
+#include "processingbench.h"
+
+#include <string>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+constexpr auto MIN_ARGUMENTS_COUNT = 2;         /// < how many arguments this applications expects in argv[] at least
+constexpr auto MODE_ARG_INDEX = 1;              /// < index of argument, which contains benchmark name
+constexpr auto IPADDRESS_ARG_INDEX = 2;         /// < index of argument, which contains echoServer's ip address
+constexpr auto PORT_ARG_INDEX = 3;              /// < index of argument, which contains echoServer's port number
+constexpr auto FIRST_NETWORK_OPTION_INDEX = 4;  /// < index of the first optional argument of network benchmarks
+
+const std::string udpFloodMode = "udp";         /// < UDP throughput benchmark
+const std::string udpLatencyMode = "udplat";    /// < UDP round-trip latency benchmark
+const std::string tcpConnectionsMode = "tcp";   /// < TCP memory per connection and throughput benchmark
+const std::string formattingMode = "format";    /// < number list formatting benchmark
+const std::string processingMode = "process";   /// < parallel message processing benchmark
+
+/// @brief print usage hint for application
+void printUsageHint()
+{
+    std::cout << "Usage: echoBench <benchmark> [arguments]\n"
+                 "Benchmarks:\n"
+                 "  " << udpFloodMode << " <server ip> <server port> [--count N] [--size BYTES] [--gso]\n"
+                 "      floods echo server with UDP datagrams and measures echo throughput\n"
+                 "  " << udpLatencyMode << " <server ip> <server port> [--count N] [--size BYTES] [--cpu CPU]\n"
+                 "      sends UDP datagrams one at a time and reports round-trip latency percentiles\n"
+                 "  " << tcpConnectionsMode << " <server ip> <server port> [--connections N] [--messages N] [--size BYTES] [--server-pid PID]\n"
+                 "      opens many TCP connections, reports server memory per connection and echo throughput\n"
+                 "  " << formattingMode << " [--numbers N] [--iterations N]\n"
+                 "      compares number list formatting methods used for the message report\n"
+                 "  " << processingMode << " [--numbers N] [--iterations N] [--threads N]\n"
+                 "      measures scanning, sorting and summing numbers of growing messages with 1 to N threads\n"
+              << globals::acceptedPortsString;
+}
+
+/// @brief reads unsigned numeric value of an option
+/// @param argc arguments count
+/// @param argv arguments
+/// @param index index of the option's name, advanced to the option's value
+/// @param value variable to store value to
+/// @returns true if value was read, false - otherwise
+bool readOptionValue(int argc, char* argv[], int &index, uint32_t &value)
+{
+    if (index + 1 >= argc)
+    {
+        std::cerr << "Option '" << argv[index] << "' requires a value.\n";
+        return false;
+    }
+
+    ++index;
+    try
+    {
+        value = std::stoul(argv[index]);
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << "Option '" << argv[index - 1] << "' expects a number, got '" << argv[index] << "'.\n";
+        return false;
+    }
+
+    return true;
+}
+
+/// @brief reads echoServer's address from arguments
+/// @param argc arguments count
+/// @param argv arguments
+/// @param ip variable to store server's ip to
+/// @param port variable to store server's port to
+/// @returns true if address is valid, false - otherwise
+bool readServerAddress(int argc, char* argv[], std::string &ip, uint16_t &port)
+{
+    if (argc < FIRST_NETWORK_OPTION_INDEX)
+        return false;
+
+    if (!utils::ipIsValid(argv[IPADDRESS_ARG_INDEX]))
+    {
+        std::cerr << "Entered ip v4 address '" << argv[IPADDRESS_ARG_INDEX] << "' is not valid.\n";
+        return false;
+    }
+    ip = argv[IPADDRESS_ARG_INDEX];
+
+    const auto serverPort = utils::getPortFromArgumetns(argv[PORT_ARG_INDEX]);
+    if (!utils::isAllowedPortNumber(serverPort))
+    {
+        std::cerr << "Entered port number (" << serverPort << ") is not in the valid range.\n";
+        return false;
+    }
+    port = serverPort;
+
+    return true;
+}
+
+/// @brief parses arguments of the UDP throughput benchmark and runs it
+/// @returns true if arguments were valid, false - otherwise
+bool runUdpFlood(int argc, char* argv[])
+{
+    echobench::UdpFloodSettings settings;
+    if (!readServerAddress(argc, argv, settings.serverIp, settings.serverPort))
+        return false;
+
+    for (auto i = FIRST_NETWORK_OPTION_INDEX; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--count") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.datagramCount))
+                return false;
+        }
+        else if (strcmp(argv[i], "--size") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.datagramSize))
+                return false;
+        }
+        else if (strcmp(argv[i], "--gso") == 0)
+        {
+            settings.useGso = true;
+        }
+        else
+        {
+            std::cerr << "Unrecognized option '" << argv[i] << "'.\n";
+            return false;
+        }
+    }
+
+    return echobench::runUdpFlood(settings);
+}
+
+/// @brief parses arguments of the UDP latency benchmark and runs it
+/// @returns true if arguments were valid, false - otherwise
+bool runUdpLatency(int argc, char* argv[])
+{
+    echobench::UdpLatencySettings settings;
+    if (!readServerAddress(argc, argv, settings.serverIp, settings.serverPort))
+        return false;
+
+    for (auto i = FIRST_NETWORK_OPTION_INDEX; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--count") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.requestCount))
+                return false;
+        }
+        else if (strcmp(argv[i], "--size") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.datagramSize))
+                return false;
+        }
+        else if (strcmp(argv[i], "--cpu") == 0)
+        {
+            uint32_t cpu = 0;
+            if (!readOptionValue(argc, argv, i, cpu))
+                return false;
+            settings.cpu = cpu;
+        }
+        else
+        {
+            std::cerr << "Unrecognized option '" << argv[i] << "'.\n";
+            return false;
+        }
+    }
+
+    return echobench::runUdpLatency(settings);
+}
+
+/// @brief parses arguments of the TCP connections benchmark and runs it
+/// @returns true if arguments were valid, false - otherwise
+bool runTcpConnections(int argc, char* argv[])
+{
+    echobench::TcpConnectionsSettings settings;
+    if (!readServerAddress(argc, argv, settings.serverIp, settings.serverPort))
+        return false;
+
+    for (auto i = FIRST_NETWORK_OPTION_INDEX; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--connections") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.connectionCount))
+                return false;
+        }
+        else if (strcmp(argv[i], "--messages") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.messageCount))
+                return false;
+        }
+        else if (strcmp(argv[i], "--size") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.messageSize))
+                return false;
+        }
+        else if (strcmp(argv[i], "--server-pid") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.serverPid))
+                return false;
+        }
+        else
+        {
+            std::cerr << "Unrecognized option '" << argv[i] << "'.\n";
+            return false;
+        }
+    }
+
+    return echobench::runTcpConnections(settings);
+}
+
+/// @brief parses arguments of the formatting benchmark and runs it
+/// @returns true if arguments were valid, false - otherwise
+bool runFormatting(int argc, char* argv[])
+{
+    echobench::FormattingSettings settings;
+    for (auto i = MODE_ARG_INDEX + 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--numbers") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.numberCount))
+                return false;
+        }
+        else if (strcmp(argv[i], "--iterations") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.iterations))
+                return false;
+        }
+        else
+        {
+            std::cerr << "Unrecognized option '" << argv[i] << "'.\n";
+            return false;
+        }
+    }
+
+    return echobench::runFormatting(settings);
+}
+
+/// @brief parses arguments of the parallel processing benchmark and runs it
+/// @returns true if arguments were valid, false - otherwise
+bool runProcessing(int argc, char* argv[])
+{
+    echobench::ProcessingSettings settings;
+    for (auto i = MODE_ARG_INDEX + 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--numbers") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.numberCount))
+                return false;
+        }
+        else if (strcmp(argv[i], "--iterations") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.iterations))
+                return false;
+        }
+        else if (strcmp(argv[i], "--threads") == 0)
+        {
+            if (!readOptionValue(argc, argv, i, settings.maxThreads))
+                return false;
+        }
+        else
+        {
+            std::cerr << "Unrecognized option '" << argv[i] << "'.\n";
+            return false;
+        }
+    }
+
+    return echobench::runProcessing(settings);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc >= MIN_ARGUMENTS_COUNT)
+    {
+        utils::textToLower(argv[MODE_ARG_INDEX]);
+        const std::string mode = argv[MODE_ARG_INDEX];
+
+        bool benchmarkRun = false;
+        if (mode == udpFloodMode)
+            benchmarkRun = runUdpFlood(argc, argv);
+        else if (mode == udpLatencyMode)
+            benchmarkRun = runUdpLatency(argc, argv);
+        else if (mode == tcpConnectionsMode)
+            benchmarkRun = runTcpConnections(argc, argv);
+        else if (mode == formattingMode)
+            benchmarkRun = runFormatting(argc, argv);
+        else if (mode == processingMode)
+            benchmarkRun = runProcessing(argc, argv);
+        else
+            std::cerr << "Unrecognized benchmark '" << mode << "'.\n";
+
+        if (!benchmarkRun)
+            printUsageHint();
+    }
+    else
+    {
+        printUsageHint();
+    }
+
+    return globals::appExitCode;
+}
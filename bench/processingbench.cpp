@@ -0,0 +1,199 @@
+#include "processingbench.h"
+#include "numberformatter.h"
+#include "messagenumbers.h"
+
+#include <chrono>
+#include <thread>
+#include <limits>
+#include <random>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <iostream>
+#include <algorithm>
+
+namespace echobench
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+/// @brief generates numbers sorted in descending order, like processMessage formats them
+/// @param count how many numbers to generate
+/// @returns numbers
+std::vector<int> makeNumbers(uint32_t count)
+{
+    std::mt19937 generator(count);
+    std::uniform_int_distribution<int> distribution(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    std::vector<int> numbers(count);
+    for (auto &number : numbers)
+        number = distribution(generator);
+    std::sort(numbers.begin(), numbers.end(), [](int lhs, int rhs){ return rhs < lhs; });
+    return numbers;
+}
+
+/// @brief formats numbers the way processMessage originally did
+/// @param numbers numbers to format, must not be empty
+/// @returns number list
+std::string formatWithAccumulate(const std::vector<int> &numbers)
+{
+    return std::accumulate(std::next(numbers.cbegin()), numbers.cend(), std::to_string(numbers.front()),
+                           [](std::string a, int b)
+                           {
+                               return std::move(a) + " " + std::to_string(b);
+                           });
+}
+
+/// @brief generates message text with numbers mixed with words and punctuation, including cases
+///        that are easy to split wrongly: numbers glued to words, minus signs and neighbouring numbers
+/// @param count how many numbers to generate
+/// @returns message text
+std::string makeMessage(uint32_t count)
+{
+    static const char *separators[] = { " ", ", ", " value=", "-", " x", "; ", "--", "abc" };
+    std::mt19937 generator(count);
+    std::uniform_int_distribution<int> distribution(-1000000, 1000000);
+    std::uniform_int_distribution<std::size_t> separator(0, sizeof separators / sizeof separators[0] - 1);
+
+    std::string message;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        message.append(separators[separator(generator)]);
+        message.append(std::to_string(distribution(generator)));
+    }
+    return message;
+}
+
+/// @brief runs a function repeatedly and measures average time of a run
+/// @param iterations number of runs
+/// @param function function to run, returns length of formatted text
+/// @param length variable to store length of formatted text to
+/// @returns average run time in microseconds
+template <typename Function>
+double measure(uint32_t iterations, Function function, std::size_t &length)
+{
+    const auto startTime = Clock::now();
+    for (uint32_t i = 0; i < iterations; ++i)
+        length = function();
+    return std::chrono::duration<double, std::micro>(Clock::now() - startTime).count() / iterations;
+}
+
+}
+
+bool runFormatting(const FormattingSettings &settings)
+{
+    if (settings.numberCount == 0 || settings.iterations == 0)
+    {
+        std::cerr << "Number count and iterations must be positive.\n";
+        return false;
+    }
+
+    const auto numbers = makeNumbers(settings.numberCount);
+
+    echoserver::NumberFormatter formatter;
+    formatter.appendList(numbers);
+    if (formatWithAccumulate(numbers) != std::string(formatter.data(), formatter.size()))
+    {
+        std::cerr << "ERROR: NumberFormatter output differs from std::to_string output!\n";
+        return false;
+    }
+
+    std::size_t accumulateLength = 0;
+    const auto accumulateTime = measure(settings.iterations, [&numbers]()
+    {
+        return formatWithAccumulate(numbers).size();
+    }, accumulateLength);
+
+    std::size_t formatterLength = 0;
+    const auto formatterTime = measure(settings.iterations, [&numbers, &formatter]()
+    {
+        formatter.clear();
+        formatter.appendList(numbers);
+        return formatter.size();
+    }, formatterLength);
+
+    std::cout << "Formatting " << settings.numberCount << " numbers (" << formatterLength << " characters), "
+              << settings.iterations << " iterations\n";
+    std::cout << "  std::accumulate + std::to_string: " << accumulateTime << " us per message\n";
+    std::cout << "  NumberFormatter:                  " << formatterTime << " us per message ("
+              << accumulateTime / formatterTime << "x)\n";
+
+    return accumulateLength == formatterLength;
+}
+
+bool runProcessing(const ProcessingSettings &settings)
+{
+    if (settings.numberCount == 0 || settings.iterations == 0)
+    {
+        std::cerr << "Number count and iterations must be positive.\n";
+        return false;
+    }
+
+    const auto maxThreads = settings.maxThreads > 0 ? settings.maxThreads
+                                                    : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::size_t> threadCounts;
+    for (std::size_t threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    // message sizes grow tenfold up to the requested one, so the table shows where threads start to pay off
+    std::vector<uint32_t> numberCounts;
+    for (uint32_t count = std::min<uint32_t>(1000, settings.numberCount); count < settings.numberCount; count *= 10)
+        numberCounts.push_back(count);
+    numberCounts.push_back(settings.numberCount);
+
+    std::cout << "Scanning, sorting and summing numbers of a message, " << settings.iterations
+              << " iterations, ms per message (speedup over 1 thread)\n";
+    std::cout << std::setw(10) << "numbers" << std::setw(12) << "bytes";
+    for (const auto threads : threadCounts)
+        std::cout << std::setw(18) << (std::to_string(threads) + (threads == 1 ? " thread" : " threads"));
+    std::cout << "\n";
+
+    auto allMatched = true;
+    for (const auto count : numberCounts)
+    {
+        const auto message = makeMessage(count);
+
+        std::vector<int> expectedNumbers;
+        auto expectedSum = 0;
+        echoserver::collectNumbers(message, nullptr, expectedNumbers, expectedSum);
+
+        std::cout << std::setw(10) << expectedNumbers.size() << std::setw(12) << message.size();
+        double singleThreadTime = 0.0;
+        for (const auto threads : threadCounts)
+        {
+            // pool is started outside of the measurement, the server starts its pool once as well
+            echoserver::WorkerPool pool(threads);
+            std::vector<int> numbers;
+            auto sum = 0;
+            std::size_t unused = 0;
+            const auto time = measure(settings.iterations, [&]()
+            {
+                echoserver::collectNumbers(message, &pool, numbers, sum);
+                return numbers.size();
+            }, unused) / 1000.0;
+
+            if (numbers != expectedNumbers || sum != expectedSum)
+            {
+                std::cerr << "\nERROR: result with " << threads << " threads differs from single-threaded one!\n";
+                allMatched = false;
+            }
+
+            if (threads == 1)
+                singleThreadTime = time;
+            std::ostringstream cell;
+            cell << std::fixed << std::setprecision(2) << time << " (" << std::setprecision(1)
+                 << singleThreadTime / time << "x)";
+            std::cout << std::setw(18) << cell.str();
+        }
+        std::cout << "\n";
+    }
+
+    return allMatched;
+}
+
+}
@@ -0,0 +1,37 @@
+#ifndef INCLUDE_ONCE_0D7C4B98_AE52_4F13_93B6_5C28E1F7D4A0
+#define INCLUDE_ONCE_0D7C4B98_AE52_4F13_93B6_5C28E1F7D4A0
+
+#include <cstdint>
+
+namespace echobench
+{
+
+/// @brief settings of the number list formatting benchmark
+struct FormattingSettings
+{
+    uint32_t numberCount = 10000;   /// < how many numbers a message contains
+    uint32_t iterations = 20;       /// < how many times every formatting method is run
+};
+
+/// @brief compares number list formatting via std::accumulate / std::to_string with NumberFormatter
+/// @param settings benchmark settings
+/// @returns true if benchmark was run
+bool runFormatting(const FormattingSettings &settings);
+
+/// @brief settings of the parallel message processing benchmark
+struct ProcessingSettings
+{
+    uint32_t numberCount = 200000;  /// < how many numbers the largest message contains
+    uint32_t iterations = 5;        /// < how many times every message is processed with every thread count
+    uint32_t maxThreads = 0;        /// < largest thread count to measure, 0 - one per core
+};
+
+/// @brief measures collectNumbers (scan, sort and sum) on messages of growing size with growing thread count,
+///        checks that parallel results match single-threaded ones
+/// @param settings benchmark settings
+/// @returns true if benchmark was run and all results matched
+bool runProcessing(const ProcessingSettings &settings);
+
+}
+
+#endif // include guard
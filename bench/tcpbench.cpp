@@ -0,0 +1,197 @@
+#include "tcpbench.h"
+#include "globals.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+namespace echobench
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto echoWaitTimeoutSec = 5;  /// < how long a connection waits for an echo before it is counted as lost
+
+/// @brief memory usage of a process
+struct ProcessMemory
+{
+    long residentKb = 0;    /// < VmRSS
+    long virtualKb = 0;     /// < VmSize
+    long threads = 0;       /// < number of threads
+};
+
+/// @brief reads memory usage of a process from /proc/<pid>/status
+/// @param pid process id
+/// @returns memory usage, zeroes if it couldn't be read
+ProcessMemory readProcessMemory(uint32_t pid)
+{
+    ProcessMemory memory;
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string key;
+    while (status >> key)
+    {
+        if (key == "VmRSS:")
+            status >> memory.residentKb;
+        else if (key == "VmSize:")
+            status >> memory.virtualKb;
+        else if (key == "Threads:")
+            status >> memory.threads;
+        status.ignore(256, '\n');
+    }
+    return memory;
+}
+
+/// @brief opens TCP connection to the echoServer
+/// @param serverAddress address of the echoServer
+/// @returns socket descriptor or globals::failureToInitCode
+int connectTcpSocket(const sockaddr_in &serverAddress)
+{
+    const auto socketDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+    if (socketDescriptor == globals::failureToInitCode)
+        return globals::failureToInitCode;
+
+    if (connect(socketDescriptor, reinterpret_cast<const sockaddr*>(&serverAddress), sizeof serverAddress) == globals::failureToConnectCode)
+    {
+        close(socketDescriptor);
+        return globals::failureToInitCode;
+    }
+
+    // lost echo must fail the read instead of hanging the benchmark
+    timeval timeout;
+    timeout.tv_sec = echoWaitTimeoutSec;
+    timeout.tv_usec = 0;
+    setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+
+    return socketDescriptor;
+}
+
+/// @brief reads exactly size bytes of echo
+/// @param socketDescriptor connected socket
+/// @param buffer buffer to read into
+/// @param size expected echo size
+/// @returns true if the whole echo was read, false - if connection failed or echo timed out
+bool readEcho(int socketDescriptor, char *buffer, std::size_t size)
+{
+    std::size_t received = 0;
+    while (received < size)
+    {
+        const auto rSize = recv(socketDescriptor, buffer + received, size - received, 0);
+        if (rSize <= 0)
+            return false;
+        received += rSize;
+    }
+    return true;
+}
+
+/// @brief prints difference in server memory usage
+/// @param title what happened between readings
+/// @param before memory usage before
+/// @param after memory usage after
+/// @param connections number of connections opened between readings
+void printMemoryDelta(const std::string &title, const ProcessMemory &before, const ProcessMemory &after, uint32_t connections)
+{
+    std::cout << "  " << title << ": server threads " << before.threads << " -> " << after.threads
+              << ", VmRSS +" << after.residentKb - before.residentKb << " KiB ("
+              << static_cast<double>(after.residentKb - before.residentKb) / connections << " KiB per connection), VmSize +"
+              << after.virtualKb - before.virtualKb << " KiB ("
+              << static_cast<double>(after.virtualKb - before.virtualKb) / connections << " KiB per connection)\n";
+}
+
+}
+
+bool runTcpConnections(const TcpConnectionsSettings &settings)
+{
+    if (settings.connectionCount == 0 || settings.messageSize == 0)
+    {
+        std::cerr << "Connection count and message size must be positive.\n";
+        return false;
+    }
+
+    sockaddr_in serverAddress;
+    std::memset(&serverAddress, 0x00, sizeof serverAddress);
+    serverAddress.sin_family = AF_INET;
+    serverAddress.sin_addr.s_addr = inet_addr(settings.serverIp.c_str());
+    serverAddress.sin_port = htons(settings.serverPort);
+
+    const auto memoryBefore = settings.serverPid != 0 ? readProcessMemory(settings.serverPid) : ProcessMemory();
+
+    std::vector<int> sockets;
+    sockets.reserve(settings.connectionCount);
+    for (uint32_t i = 0; i < settings.connectionCount; ++i)
+    {
+        const auto socketDescriptor = connectTcpSocket(serverAddress);
+        if (socketDescriptor == globals::failureToInitCode)
+        {
+            std::cerr << "ERROR: failed to open connection #" << i + 1 << " to the EchoServer@" << settings.serverIp
+                      << ":" << settings.serverPort << " (" << std::strerror(errno) << ").\n";
+            break;
+        }
+        sockets.push_back(socketDescriptor);
+    }
+
+    const std::string message = [&settings]()
+    {
+        static const std::string pattern = "17 -4 256 3 -1024 99 ";
+        std::string text;
+        while (text.size() < settings.messageSize)
+            text.append(pattern, 0, std::min<std::size_t>(pattern.size(), settings.messageSize - text.size()));
+        return text;
+    }();
+    std::vector<char> buffer(message.size());
+
+    // every connection exchanges one message so thread-per-connection server has created and touched its buffers
+    std::size_t activeConnections = 0;
+    for (const auto socketDescriptor : sockets)
+    {
+        if (send(socketDescriptor, message.data(), message.size(), MSG_NOSIGNAL) >= 0
+                && readEcho(socketDescriptor, buffer.data(), message.size()))
+            ++activeConnections;
+    }
+    // giving server a moment to finish processing before the memory reading
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::cout << "TCP connections: " << activeConnections << " of " << settings.connectionCount << " active\n";
+    if (settings.serverPid != 0 && activeConnections > 0)
+        printMemoryDelta("after connecting", memoryBefore, readProcessMemory(settings.serverPid), activeConnections);
+
+    // every round sends one message over each connection, then collects all the echoes
+    uint64_t echoes = 0;
+    const auto startTime = Clock::now();
+    for (uint32_t round = 0; round < settings.messageCount; ++round)
+    {
+        for (const auto socketDescriptor : sockets)
+            send(socketDescriptor, message.data(), message.size(), MSG_NOSIGNAL);
+        for (const auto socketDescriptor : sockets)
+        {
+            if (readEcho(socketDescriptor, buffer.data(), message.size()))
+                ++echoes;
+        }
+    }
+    const auto seconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+
+    if (seconds > 0)
+    {
+        std::cout << "  echoes: " << echoes << " in " << seconds << " s, " << echoes / seconds << " messages/s, "
+                  << echoes * static_cast<double>(message.size()) / seconds / (1024 * 1024) << " MiB/s\n";
+    }
+
+    for (const auto socketDescriptor : sockets)
+        close(socketDescriptor);
+
+    return true;
+}
+
+}
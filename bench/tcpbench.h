@@ -0,0 +1,29 @@
+#ifndef INCLUDE_ONCE_5F9D2A7C_E31B_4B68_8C40_A6E1D7B39F02
+#define INCLUDE_ONCE_5F9D2A7C_E31B_4B68_8C40_A6E1D7B39F02
+
+#include <string>
+#include <cstdint>
+
+namespace echobench
+{
+
+/// @brief settings of the TCP connections benchmark
+struct TcpConnectionsSettings
+{
+    std::string serverIp;               /// < ip v4 address of the echoServer
+    uint16_t serverPort = 0;            /// < port of the echoServer
+    uint32_t connectionCount = 100;     /// < how many simultaneous connections to open
+    uint32_t messageCount = 100;        /// < how many messages every connection sends
+    uint32_t messageSize = 64;          /// < size of every message
+    uint32_t serverPid = 0;             /// < echoServer's process id for memory readings, 0 - don't read
+};
+
+/// @brief opens many simultaneous TCP connections to echoServer, reports server memory per connection
+///        and echo throughput with all connections active
+/// @param settings benchmark settings
+/// @returns true if benchmark was run, false - if it couldn't be set up
+bool runTcpConnections(const TcpConnectionsSettings &settings);
+
+}
+
+#endif // include guard
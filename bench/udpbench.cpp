@@ -0,0 +1,329 @@
+#include "udpbench.h"
+#include "globals.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+namespace echobench
+{
+
+namespace
+{
+
+constexpr auto socketBufferSize = 8 * 1024 * 1024;    /// < requested socket buffer size, so bursts aren't dropped locally
+constexpr auto echoWaitTimeoutSec = 1;                /// < how long receiver waits for late echoes
+constexpr auto maxSendAttempts = 3;                   /// < how many times a datagram is sent before it is skipped
+constexpr std::size_t sequenceTagWidth = 10;          /// < digits of the sequence number a latency request starts with
+
+using Clock = std::chrono::steady_clock;
+
+/// @brief builds a datagram payload made of numbers separated with spaces
+/// @param size payload size
+/// @returns payload text
+std::string makePayload(uint32_t size)
+{
+    static const std::string pattern = "17 -4 256 3 -1024 99 ";
+    std::string payload;
+    payload.reserve(size);
+    while (payload.size() < size)
+        payload.append(pattern, 0, std::min<std::size_t>(pattern.size(), size - payload.size()));
+    return payload;
+}
+
+/// @brief writes request's sequence number at the beginning of the payload, so its echo can be told apart from
+///        late echoes of earlier requests; payloads shorter than sequenceTagWidth keep only the lowest digits
+/// @param payload payload to tag
+/// @param sequence sequence number of the request
+void tagPayload(std::string &payload, uint32_t sequence)
+{
+    const auto width = std::min(sequenceTagWidth, payload.size());
+    for (auto i = width; i > 0; --i)
+    {
+        payload[i - 1] = static_cast<char>('0' + sequence % 10);
+        sequence /= 10;
+    }
+    if (payload.size() > width)
+        payload[width] = ' ';
+}
+
+/// @brief creates UDP socket connected to the echoServer, with large buffers and receive timeout
+/// @param serverIp ip v4 address of the echoServer
+/// @param serverPort port of the echoServer
+/// @returns socket descriptor or globals::failureToInitCode
+int connectUdpSocket(const std::string &serverIp, uint16_t serverPort)
+{
+    const auto socketDescriptor = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socketDescriptor == globals::failureToInitCode)
+    {
+        std::cerr << "ERROR: failed to create a UDP socket!\n";
+        return globals::failureToInitCode;
+    }
+
+    sockaddr_in serverAddress;
+    std::memset(&serverAddress, 0x00, sizeof serverAddress);
+    serverAddress.sin_family = AF_INET;
+    serverAddress.sin_addr.s_addr = inet_addr(serverIp.c_str());
+    serverAddress.sin_port = htons(serverPort);
+
+    if (connect(socketDescriptor, reinterpret_cast<sockaddr*>(&serverAddress), sizeof serverAddress) == globals::failureToConnectCode)
+    {
+        std::cerr << "ERROR: failed to connect to the EchoServer@" << serverIp << ":" << serverPort << ".\n";
+        close(socketDescriptor);
+        return globals::failureToInitCode;
+    }
+
+    setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVBUF, &socketBufferSize, sizeof socketBufferSize);
+    setsockopt(socketDescriptor, SOL_SOCKET, SO_SNDBUF, &socketBufferSize, sizeof socketBufferSize);
+    timeval timeout;
+    timeout.tv_sec = echoWaitTimeoutSec;
+    timeout.tv_usec = 0;
+    setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+
+    return socketDescriptor;
+}
+
+/// @brief returns value at given percentile of sorted samples
+/// @param sortedSamples samples sorted in ascending order, must not be empty
+/// @param percentile percentile within 0 - 100
+/// @returns sample value
+double percentileOf(const std::vector<double> &sortedSamples, double percentile)
+{
+    const auto index = static_cast<std::size_t>(percentile / 100.0 * (sortedSamples.size() - 1) + 0.5);
+    return sortedSamples[std::min(index, sortedSamples.size() - 1)];
+}
+
+/// @brief sends a batch of equally-sized datagrams with one UDP_SEGMENT (GSO) call
+/// @param socketDescriptor connected UDP socket
+/// @param batch buffer holding datagrams back to back
+/// @param batchSize size of the buffer
+/// @param segmentSize size of every datagram
+/// @returns true if kernel accepted the batch, false - otherwise
+bool sendGsoBatch(int socketDescriptor, const std::string &batch, std::size_t batchSize, uint16_t segmentSize)
+{
+    iovec iov;
+    iov.iov_base = const_cast<char*>(batch.data());
+    iov.iov_len = batchSize;
+
+    // union aligns the buffer for cmsghdr, a plain char array may be misaligned
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(uint16_t))];
+        cmsghdr align;
+    } control;
+    std::memset(&control, 0x00, sizeof control);
+
+    msghdr message;
+    std::memset(&message, 0x00, sizeof message);
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof control.buffer;
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = globals::udpSegmentOption;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    std::memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof segmentSize);
+
+    return sendmsg(socketDescriptor, &message, 0) >= 0;
+}
+
+}
+
+bool runUdpFlood(const UdpFloodSettings &settings)
+{
+    if (settings.datagramSize == 0 || settings.datagramSize > globals::maxUdpPayloadSize)
+    {
+        std::cerr << "Datagram size must be within 1 - " << globals::maxUdpPayloadSize << " bytes.\n";
+        return false;
+    }
+
+    const auto socketDescriptor = connectUdpSocket(settings.serverIp, settings.serverPort);
+    if (socketDescriptor == globals::failureToInitCode)
+        return false;
+
+    std::atomic<bool> sendingDone(false);
+    std::atomic<uint32_t> received(0);
+    Clock::time_point lastEchoTime;
+
+    std::thread receiver([&]()
+    {
+        std::vector<char> buffer(globals::defaultBufferSize);
+        while (received < settings.datagramCount)
+        {
+            const auto rSize = recv(socketDescriptor, buffer.data(), buffer.size(), 0);
+            if (rSize < 0)
+            {
+                if (sendingDone)
+                    break;
+                continue;
+            }
+            lastEchoTime = Clock::now();
+            ++received;
+        }
+    });
+
+    const auto payload = makePayload(settings.datagramSize);
+    const auto batchLength = settings.useGso
+            ? std::max<std::size_t>(1, std::min<std::size_t>(globals::maxGsoSegments, globals::maxUdpPayloadSize / settings.datagramSize))
+            : 1;
+    std::string batch;
+    for (std::size_t i = 0; i < batchLength; ++i)
+        batch += payload;
+
+    uint32_t sent = 0;
+    uint32_t skipped = 0;
+    uint32_t sendCalls = 0;
+    bool gsoFailed = false;
+    const auto startTime = Clock::now();
+
+    while (sent + skipped < settings.datagramCount)
+    {
+        const auto datagrams = std::min<std::size_t>(batchLength, settings.datagramCount - sent - skipped);
+        if (datagrams > 1 && !gsoFailed)
+        {
+            ++sendCalls;
+            if (sendGsoBatch(socketDescriptor, batch, datagrams * settings.datagramSize, settings.datagramSize))
+            {
+                sent += datagrams;
+                continue;
+            }
+            // the batch is not lost - its datagrams are sent one by one below
+            std::cerr << "WARNING: UDP_SEGMENT send failed (" << std::strerror(errno) << "), sending one datagram per call.\n";
+            gsoFailed = true;
+        }
+
+        // a datagram the kernel keeps refusing (e.g. ECONNREFUSED from a stopped server) is skipped, not retried forever
+        auto attempt = 0;
+        while (attempt < maxSendAttempts && send(socketDescriptor, payload.data(), payload.size(), 0) < 0)
+        {
+            ++attempt;
+            ++sendCalls;
+        }
+        if (attempt < maxSendAttempts)
+        {
+            ++sent;
+            ++sendCalls;
+        }
+        else
+        {
+            ++skipped;
+        }
+    }
+
+    const auto sendTime = Clock::now();
+    sendingDone = true;
+    receiver.join();
+    close(socketDescriptor);
+
+    const auto sendSeconds = std::chrono::duration<double>(sendTime - startTime).count();
+    const auto echoSeconds = received > 0 ? std::chrono::duration<double>(lastEchoTime - startTime).count() : 0.0;
+
+    std::cout << "UDP flood: " << sent << " datagrams of " << settings.datagramSize << " bytes in "
+              << sendCalls << " send calls" << (settings.useGso && !gsoFailed ? " (GSO)" : "") << "\n";
+    if (skipped > 0)
+        std::cout << "  skipped after " << maxSendAttempts << " failed send attempts: " << skipped << " datagrams\n";
+    std::cout << "  send rate: " << (sendSeconds > 0 ? sent / sendSeconds : 0.0) << " datagrams/s\n";
+    std::cout << "  echoes received: " << received << " (" << 100.0 * (sent - received) / std::max<uint32_t>(sent, 1)
+              << "% lost)\n";
+    if (echoSeconds > 0)
+    {
+        std::cout << "  echo rate: " << received / echoSeconds << " datagrams/s, "
+                  << received * static_cast<double>(settings.datagramSize) / echoSeconds / (1024 * 1024) << " MiB/s\n";
+    }
+
+    return true;
+}
+
+bool runUdpLatency(const UdpLatencySettings &settings)
+{
+    if (settings.datagramSize == 0 || settings.datagramSize > globals::maxUdpPayloadSize)
+    {
+        std::cerr << "Datagram size must be within 1 - " << globals::maxUdpPayloadSize << " bytes.\n";
+        return false;
+    }
+
+    if (settings.cpu >= 0)
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(settings.cpu, &cpuSet);
+        if (pthread_setaffinity_np(pthread_self(), sizeof cpuSet, &cpuSet) != 0)
+            std::cerr << "WARNING: failed to pin benchmark thread to cpu " << settings.cpu << ".\n";
+    }
+
+    const auto socketDescriptor = connectUdpSocket(settings.serverIp, settings.serverPort);
+    if (socketDescriptor == globals::failureToInitCode)
+        return false;
+
+    auto payload = makePayload(settings.datagramSize);
+    std::vector<char> buffer(globals::defaultBufferSize);
+    std::vector<double> roundTrips;
+    roundTrips.reserve(settings.requestCount);
+    uint32_t lost = 0;
+    uint32_t lateEchoes = 0;
+
+    for (uint32_t i = 0; i < settings.requestCount; ++i)
+    {
+        tagPayload(payload, i);
+        const auto sendTime = Clock::now();
+        if (send(socketDescriptor, payload.data(), payload.size(), 0) < 0)
+        {
+            ++lost;
+            continue;
+        }
+
+        // echo of a request that already timed out may arrive first, it must not be taken for this one's;
+        // there is at most one such echo per lost request, so the loop ends
+        auto echoed = false;
+        while (true)
+        {
+            const auto rSize = recv(socketDescriptor, buffer.data(), buffer.size(), 0);
+            if (rSize < 0)
+                break;
+            if (static_cast<std::size_t>(rSize) == payload.size() && std::memcmp(buffer.data(), payload.data(), rSize) == 0)
+            {
+                echoed = true;
+                break;
+            }
+            ++lateEchoes;
+        }
+
+        if (!echoed)
+        {
+            ++lost;
+            continue;
+        }
+
+        roundTrips.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sendTime).count());
+    }
+
+    close(socketDescriptor);
+
+    std::cout << "UDP latency: " << roundTrips.size() << " round trips of " << settings.datagramSize
+              << " bytes, " << lost << " lost, " << lateEchoes << " late echoes discarded\n";
+    if (roundTrips.empty())
+        return true;
+
+    std::sort(roundTrips.begin(), roundTrips.end());
+    std::cout << "  min " << roundTrips.front() << " us; p50 " << percentileOf(roundTrips, 50)
+              << " us; p90 " << percentileOf(roundTrips, 90) << " us; p99 " << percentileOf(roundTrips, 99)
+              << " us; p99.9 " << percentileOf(roundTrips, 99.9) << " us; max " << roundTrips.back() << " us\n";
+
+    return true;
+}
+
+}
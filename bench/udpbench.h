@@ -0,0 +1,42 @@
+#ifndef INCLUDE_ONCE_3A61F0B2_5C7E_4D8A_9E13_B04D2C6F8A55
+#define INCLUDE_ONCE_3A61F0B2_5C7E_4D8A_9E13_B04D2C6F8A55
+
+#include <string>
+#include <cstdint>
+
+namespace echobench
+{
+
+/// @brief settings of the UDP throughput benchmark
+struct UdpFloodSettings
+{
+    std::string serverIp;               /// < ip v4 address of the echoServer
+    uint16_t serverPort = 0;            /// < port of the echoServer
+    uint32_t datagramCount = 100000;    /// < how many datagrams to send
+    uint32_t datagramSize = 64;         /// < payload size of every datagram
+    bool useGso = false;                /// < send datagrams in batches with UDP_SEGMENT (GSO)
+};
+
+/// @brief settings of the UDP round-trip latency benchmark
+struct UdpLatencySettings
+{
+    std::string serverIp;               /// < ip v4 address of the echoServer
+    uint16_t serverPort = 0;            /// < port of the echoServer
+    uint32_t requestCount = 10000;      /// < how many request / echo round trips to measure
+    uint32_t datagramSize = 64;         /// < payload size of every datagram
+    int cpu = -1;                       /// < core the benchmark thread is pinned to, -1 - not pinned
+};
+
+/// @brief floods echoServer with UDP datagrams and measures how fast the echoes come back
+/// @param settings benchmark settings
+/// @returns true if benchmark was run, false - if it couldn't be set up
+bool runUdpFlood(const UdpFloodSettings &settings);
+
+/// @brief sends datagrams to echoServer one at a time and reports round-trip latency percentiles
+/// @param settings benchmark settings
+/// @returns true if benchmark was run, false - if it couldn't be set up
+bool runUdpLatency(const UdpLatencySettings &settings);
+
+}
+
+#endif // include guard
@@ -2,7 +2,10 @@
 #include "globals.h"
 
 #include <future>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
+#include <poll.h>
 #include <unistd.h>
 #include <algorithm>
 #include <arpa/inet.h>
@@ -12,6 +15,14 @@
 namespace echoclient
 {
 
+namespace
+{
+
+constexpr std::size_t maxUnansweredMessages = 64;   /// < how many unanswered messages UdpSender recognizes late echoes of
+constexpr auto udpReceiveTimeoutMs = 5000;          /// < how long interactive UDP sender waits for an echo, datagram may be lost
+
+}
+
 //---------------------------------------------------------
 
 BaseSender::BaseSender(const std::string &serverIp, uint16_t serverPort, uint32_t bufferSize)
@@ -42,6 +53,29 @@ bool BaseSender::prepareSocket(int type, const std::string &typeString)
     return true;
 }
 
+bool BaseSender::connectToServer()
+{
+    const socklen_t serverAddressLength = sizeof serverAddress_;
+    const auto connection = connect(socketDescriptor_, reinterpret_cast<sockaddr*>(&serverAddress_), serverAddressLength);
+    if (connection == globals::failureToConnectCode)
+    {
+        std::cerr << "ERROR: failed to connect to the EchoServer@" << inet_ntoa(serverAddress_.sin_addr)
+                  << ":" << ntohs(serverAddress_.sin_port) << ".\n";
+        return false;
+    }
+
+    return true;
+}
+
+void BaseSender::setReceiveTimeout(int milliseconds)
+{
+    receiveTimeoutMs_ = milliseconds;
+    timeval timeout;
+    timeout.tv_sec = milliseconds / 1000;
+    timeout.tv_usec = (milliseconds % 1000) * 1000;
+    setsockopt(socketDescriptor_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+}
+
 //=========================================================
 
 TcpSender::TcpSender(const std::string &serverIp, uint16_t serverPort, uint32_t bufferSize)
@@ -52,6 +86,36 @@ TcpSender::TcpSender(const std::string &serverIp, uint16_t serverPort, uint32_t
 
 //---------------------------------------------------------
 
+bool TcpSender::exchange(const char *data, std::size_t size, std::string &response)
+{
+    std::lock_guard<std::mutex> lock(exchangeMutex_);
+    std::size_t sent = 0;
+    while (sent < size)
+    {
+        const auto sSize = send(socketDescriptor_, data + sent, size - sent, MSG_NOSIGNAL);
+        if (sSize < 0 && errno == EINTR)
+            continue;
+        if (sSize < 0)
+            return false;
+        sent += sSize;
+    }
+
+    // echo is exactly as long as the message, but stream may deliver it in several parts
+    response.resize(size);
+    std::size_t received = 0;
+    while (received < size)
+    {
+        const auto rSize = recv(socketDescriptor_, &response[received], size - received, 0);
+        if (rSize < 0 && errno == EINTR)
+            continue;
+        if (rSize <= 0)
+            return false;
+        received += rSize;
+    }
+
+    return true;
+}
+
 void TcpSender::run()
 {
     if (!isInitialized_)
@@ -60,18 +124,12 @@ void TcpSender::run()
         return;
     }
 
-    const socklen_t serverAddressLength = sizeof serverAddress_;
-    const auto connection = connect(socketDescriptor_, reinterpret_cast<sockaddr*>(&serverAddress_), serverAddressLength);
-    if (connection == globals::failureToConnectCode)
-    {
-        std::cerr << "ERROR: failed to connect to the EchoServer@" << inet_ntoa(serverAddress_.sin_addr)
-                  << ":" << ntohs(serverAddress_.sin_port) << ".\n";
+    if (!connectToServer())
         return;
-    }
 
     std::cout << globals::echoClientRunMessage;
-    char *buffer = new char [bufferSize_];
     std::string inputString;
+    std::string response;
 
     while (true)
     {
@@ -80,28 +138,16 @@ void TcpSender::run()
             break;
 
         const auto strLenToSend = std::min(static_cast<uint32_t>(inputString.size()), bufferSize_);
-        std::memset(buffer, 0x00, bufferSize_);
-        std::memcpy(buffer, inputString.c_str(), strLenToSend);
-
-        const auto sSize = send(socketDescriptor_, buffer, strLenToSend, 0);
-        if (sSize < 0)
-        {
-            std::cerr << "Failed to send message to EchoServer@" << inet_ntoa(serverAddress_.sin_addr)
-                      << ":" << ntohs(serverAddress_.sin_port) << ".\n";
-        }
-
-        std::memset(buffer, 0x00, bufferSize_);
-        const auto rSize = recv(socketDescriptor_, buffer, bufferSize_, 0);
-        if (rSize < 0)
+        if (!exchange(inputString.c_str(), strLenToSend, response))
         {
-            std::cerr << "Failed to receive a response from EchoServer@" << inet_ntoa(serverAddress_.sin_addr)
+            std::cerr << "Failed to exchange message with EchoServer@" << inet_ntoa(serverAddress_.sin_addr)
                       << ":" << ntohs(serverAddress_.sin_port) << ".\n";
+            continue;
         }
 
         std::cout << "EchoServer@" << inet_ntoa(serverAddress_.sin_addr) << ":" << ntohs(serverAddress_.sin_port)
-                  << " response: " << buffer << "\n";
+                  << " response: " << response << "\n";
     }
-    delete buffer;
 }
 
 //=========================================================
@@ -114,19 +160,86 @@ UdpSender::UdpSender(const std::string &serverIp, uint16_t serverPort, uint32_t
 
 //---------------------------------------------------------
 
+bool UdpSender::receiveDatagram(std::string &response, std::chrono::steady_clock::time_point deadline)
+{
+    response.resize(bufferSize_);
+    while (true)
+    {
+        if (receiveTimeoutMs_ > 0)
+        {
+            // whole exchange is limited, not every single receive, so late echoes can't extend the wait
+            const auto timeLeft = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                      deadline - std::chrono::steady_clock::now()).count();
+            if (timeLeft <= 0)
+                return false;
+
+            pollfd descriptor;
+            descriptor.fd = socketDescriptor_;
+            descriptor.events = POLLIN;
+            descriptor.revents = 0;
+            const auto ready = poll(&descriptor, 1, static_cast<int>(timeLeft));
+            if (ready < 0 && errno == EINTR)
+                continue;
+            if (ready <= 0)
+                return false;
+        }
+
+        const auto rSize = recv(socketDescriptor_, &response[0], bufferSize_, 0);
+        if (rSize < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+            continue;
+        if (rSize < 0)
+            return false;
+
+        response.resize(rSize);
+        return true;
+    }
+}
+
+bool UdpSender::forgetUnanswered(const std::string &datagram)
+{
+    const auto found = std::find(unansweredMessages_.begin(), unansweredMessages_.end(), datagram);
+    if (found == unansweredMessages_.end())
+        return false;
+
+    unansweredMessages_.erase(found);
+    return true;
+}
+
+bool UdpSender::exchange(const char *data, std::size_t size, std::string &response)
+{
+    std::lock_guard<std::mutex> lock(exchangeMutex_);
+
+    // echoes that arrived after an earlier exchange gave up on them are dropped before sending
+    response.resize(bufferSize_);
+    ssize_t rSize = 0;
+    while ((rSize = recv(socketDescriptor_, &response[0], bufferSize_, MSG_DONTWAIT)) >= 0)
+        forgetUnanswered(response.substr(0, rSize));
+
+    if (send(socketDescriptor_, data, size, MSG_CONFIRM) < 0)
+        return false;
+
+    // late echo of an earlier message may still be in flight and arrive first, it is skipped;
+    // any other datagram is the server's response to this message, whether it matches or not
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(receiveTimeoutMs_);
+    while (receiveDatagram(response, deadline))
+    {
+        if ((response.size() == size && std::memcmp(response.data(), data, size) == 0) || !forgetUnanswered(response))
+            return true;
+    }
+
+    // remembered, so its echo isn't taken for a response to one of the following messages
+    unansweredMessages_.emplace_back(data, size);
+    if (unansweredMessages_.size() > maxUnansweredMessages)
+        unansweredMessages_.pop_front();
+    return false;
+}
+
 void UdpSender::sendMessage(const std::string message)
 {
-    socklen_t serverAddressLength = sizeof serverAddress_;
     const auto strLenToSend = std::min(static_cast<uint32_t>(message.size()), bufferSize_);
 
-    sendto(socketDescriptor_, message.c_str(), strLenToSend, MSG_CONFIRM,
-                              reinterpret_cast<sockaddr*>(&serverAddress_), serverAddressLength);
-
-    char *buffer = new char [bufferSize_];
-    std::memset(buffer, 0x00, bufferSize_);
-    const auto rSize = recvfrom(socketDescriptor_, buffer, bufferSize_, MSG_WAITALL,
-                                reinterpret_cast<sockaddr*>(&serverAddress_), &serverAddressLength);
-    if (rSize < 0)
+    std::string response;
+    if (!exchange(message.c_str(), strLenToSend, response))
     {
         std::cerr << "Failed to receive a response from EchoServer@" << inet_ntoa(serverAddress_.sin_addr)
                   << ":" << ntohs(serverAddress_.sin_port) << ".\n";
@@ -134,9 +247,8 @@ void UdpSender::sendMessage(const std::string message)
     else
     {
         std::cout << "EchoServer@" << inet_ntoa(serverAddress_.sin_addr) << ":" << ntohs(serverAddress_.sin_port)
-                  << " response: " << buffer << "\n";
+                  << " response: " << response << "\n";
     }
-    delete buffer;
 }
 
 void UdpSender::run()
@@ -147,6 +259,10 @@ void UdpSender::run()
         return;
     }
 
+    if (!connectToServer())
+        return;
+
+    setReceiveTimeout(udpReceiveTimeoutMs);
     std::cout << globals::echoClientRunMessage;
     std::string inputString;
 
@@ -156,6 +272,7 @@ void UdpSender::run()
         if (inputString == "q" || inputString == "quit")
             break;
 
+        // threads share the socket, exchange() serializes them
         std::thread(&UdpSender::sendMessage, this, inputString).detach();
     }
 }
@@ -1,7 +1,11 @@
 #ifndef INCLUDE_ONCE_20B79509_8CB6_41DE_A433_A86A2B72C365
 #define INCLUDE_ONCE_20B79509_8CB6_41DE_A433_A86A2B72C365
 
+#include <deque>
+#include <mutex>
+#include <chrono>
 #include <string>
+#include <cstddef>
 #include <netinet/in.h>
 
 namespace echoclient
@@ -32,6 +36,19 @@ public:
     bool isInitialized() const { return isInitialized_; }
     /// @brief runs echoClient sender
     virtual void run() = 0;
+    /// @brief connects sender's socket to the EchoServer, so messages can be exchanged with it
+    /// @returns true if socket was connected, false - otherwise
+    bool connectToServer();
+    /// @brief limits how long exchange() waits for the server's response
+    /// @param milliseconds receive timeout, 0 - wait forever
+    void setReceiveTimeout(int milliseconds);
+    /// @brief sends message to the connected EchoServer and receives its echo
+    /// @param data message to send
+    /// @param size size of the message
+    /// @param response string to store the echo to
+    /// @returns true if message was sent and a response was received, false - otherwise;
+    ///          exchanges of one sender are serialized, so different threads may call it at the same time
+    virtual bool exchange(const char *data, std::size_t size, std::string &response) = 0;
 
 protected:
     /// @brief creates sender's socket
@@ -43,6 +60,8 @@ protected:
     int socketDescriptor_;          /// < descriptor of the listener's socket
     sockaddr_in serverAddress_;     /// < address bound to the listener's socket
     uint32_t bufferSize_;           /// < size of the listener's read buffer
+    int receiveTimeoutMs_ = 0;      /// < how long exchange() waits for a response, 0 - forever
+    std::mutex exchangeMutex_;      /// < serializes exchanges, so concurrent callers don't take each other's responses
 
     bool isInitialized_ = false;    /// < true if the listener's was socket created and bound successfully
 };
@@ -58,6 +77,8 @@ public:
     TcpSender(const std::string &serverIp, uint16_t serverPort, uint32_t bufferSize);
     /// @brief runs the echoClient TCP sender
     void run() override;
+    /// @brief sends message and receives its echo, which may arrive in several parts
+    bool exchange(const char *data, std::size_t size, std::string &response) override;
 };
 
 /// @brief class for echoClient sender that uses UDP protocol
@@ -71,10 +92,26 @@ public:
     UdpSender(const std::string &serverIp, uint16_t serverPort, uint32_t bufferSize);
     /// @brief runs the echoClient UDP sender
     void run() override;
+    /// @brief sends message as a single datagram and receives the echo datagram; late echoes of earlier messages
+    ///        that timed out are recognized by their payload and discarded instead of being taken for this one,
+    ///        any other datagram is returned as the response, even if it differs from the message
+    bool exchange(const char *data, std::size_t size, std::string &response) override;
 private:
+    /// @brief receives one datagram, waiting no longer than the deadline if receive timeout is set
+    /// @param response string to store the datagram to
+    /// @param deadline when waiting ends, ignored without receive timeout
+    /// @returns true if a datagram was received, false - on error or timeout
+    bool receiveDatagram(std::string &response, std::chrono::steady_clock::time_point deadline);
+    /// @brief forgets message whose echo has arrived late
+    /// @param datagram received datagram
+    /// @returns true if datagram is a late echo of an unanswered message, false - otherwise
+    bool forgetUnanswered(const std::string &datagram);
+
     /// @brief method that handles actually sending message to EchoServer and getting its response
     /// @param message string with text to send
     void sendMessage(const std::string message);
+
+    std::deque<std::string> unansweredMessages_;    /// < latest messages whose echo timed out, their echoes may still arrive
 };
 
 }
@@ -1,6 +1,7 @@
 #include "utils.h"
 #include "globals.h"
 #include "echoclient.h"
+#include "replay.h"
 
 #include <memory>
 #include <cstring>
@@ -14,17 +15,98 @@ constexpr auto PROTOCOL_ARG_INDEX = 1;          /// < index of argument, which c
 constexpr auto IPADDRESS_ARG_INDEX = 2;         /// < index of argument, which contains echoServer's ip address
 constexpr auto PORT_ARG_INDEX = 3;              /// < index of argument, which contains echoServer's port number
 
+constexpr auto MIN_REPLAY_ARGUMENTS_COUNT = 5;  /// < how many arguments replay mode expects in argv[] at least
+constexpr auto CAPTURE_ARG_INDEX = 2;           /// < index of argument, which contains capture file in replay mode
+constexpr auto REPLAY_IPADDRESS_ARG_INDEX = 3;  /// < index of argument, which contains echoServer's ip address in replay mode
+constexpr auto REPLAY_PORT_ARG_INDEX = 4;       /// < index of argument, which contains echoServer's port number in replay mode
+constexpr auto REPLAY_OPTION_ARG_INDEX = 5;     /// < index of the first optional argument in replay mode
+
+const std::string replayText = "replay";        /// < replay mode string
+const std::string speedOption = "--speed";      /// < replay speed factor
+const std::string maxSpeedText = "max";         /// < replay speed value that disables pauses
+
 /// @brief print usage hint for application
 void printUsageHint()
 {
-    std::cout << "Usage: echoServer tcp|udp <server ip> <server port>\n" << globals::acceptedPortsString;
+    std::cout << "Usage: echoClient tcp|udp <server ip> <server port>\n"
+                 "       echoClient " << replayText << " <capture file> <server ip> <server port> [" << speedOption << " FACTOR|" << maxSpeedText << "]\n"
+                 "  " << replayText << " sends messages captured by 'echoServer --capture' with their recorded timing,\n"
+                 "  " << speedOption << " FACTOR replays FACTOR times faster (default 1), " << speedOption << " " << maxSpeedText
+              << " - without pauses\n"
+              << globals::acceptedPortsString;
+}
+
+/// @brief runs replay mode
+/// @param argc arguments count
+/// @param argv arguments
+void runReplay(int argc, char* argv[])
+{
+    if (!utils::ipIsValid(argv[REPLAY_IPADDRESS_ARG_INDEX]))
+    {
+        std::cerr << "Entered ip v4 address '" << argv[REPLAY_IPADDRESS_ARG_INDEX] << "' is not valid.\n";
+        printUsageHint();
+        return;
+    }
+
+    const auto serverPort = utils::getPortFromArgumetns(argv[REPLAY_PORT_ARG_INDEX]);
+    if (!utils::isAllowedPortNumber(serverPort))
+    {
+        std::cerr << "Entered port number (" << serverPort << ") is not in the valid range.\n";
+        printUsageHint();
+        return;
+    }
+
+    auto speed = 1.0;
+    for (auto i = REPLAY_OPTION_ARG_INDEX; i < argc; ++i)
+    {
+        if (speedOption == argv[i] && i + 1 < argc)
+        {
+            ++i;
+            if (maxSpeedText == argv[i])
+            {
+                speed = echoclient::maximumReplaySpeed;
+                continue;
+            }
+
+            try
+            {
+                speed = std::stod(argv[i]);
+            }
+            catch (const std::exception &)
+            {
+                speed = -1.0;
+            }
+
+            if (speed <= 0.0)
+            {
+                std::cerr << "Option '" << speedOption << "' expects a positive number or '" << maxSpeedText
+                          << "', got '" << argv[i] << "'.\n";
+                printUsageHint();
+                return;
+            }
+        }
+        else
+        {
+            std::cerr << "Unrecognized option '" << argv[i] << "'.\n";
+            printUsageHint();
+            return;
+        }
+    }
+
+    echoclient::CaptureReplay replay(argv[CAPTURE_ARG_INDEX], argv[REPLAY_IPADDRESS_ARG_INDEX], serverPort, speed);
+    if (replay.isInitialized())
+        replay.run();
 }
 
 }
 
 int main(int argc, char* argv[])
 {
-    if (argc == EXPECTED_ARGUMENTS_COUNT)
+    if (argc >= MIN_REPLAY_ARGUMENTS_COUNT && replayText == argv[PROTOCOL_ARG_INDEX])
+    {
+        runReplay(argc, argv);
+    }
+    else if (argc == EXPECTED_ARGUMENTS_COUNT)
     {
         // argv[1] = client mode :: UDP or TCP
         utils::textToLower(argv[PROTOCOL_ARG_INDEX]);
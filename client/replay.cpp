@@ -0,0 +1,227 @@
+#include "replay.h"
+#include "globals.h"
+#include "echoclient.h"
+
+#include <map>
+#include <memory>
+#include <thread>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace echoclient
+{
+
+namespace
+{
+
+constexpr auto replayReceiveTimeoutMs = 5000;   /// < how long a replayed message waits for its echo
+
+}
+
+//---------------------------------------------------------
+
+CaptureReplay::CaptureReplay(const std::string &capturePath, const std::string &serverIp, uint16_t serverPort, double speed)
+    : serverIp_(serverIp)
+    , serverPort_(serverPort)
+    , speed_(speed)
+    , sentMessages_(0)
+    , sentBytes_(0)
+    , failedMessages_(0)
+    , mismatchedEchoes_(0)
+    , maxLagMicroseconds_(0)
+{
+    isInitialized_ = mapFile(capturePath) && indexRecords();
+}
+
+CaptureReplay::~CaptureReplay()
+{
+    if (mapping_)
+        munmap(const_cast<char*>(mapping_), mappingSize_);
+}
+
+//---------------------------------------------------------
+
+bool CaptureReplay::mapFile(const std::string &capturePath)
+{
+    const auto fileDescriptor = open(capturePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor < 0)
+    {
+        std::cerr << "ERROR: failed to open capture file " << capturePath << " (" << std::strerror(errno) << ")!\n";
+        return false;
+    }
+
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) != 0 || static_cast<std::size_t>(fileStatus.st_size) < sizeof(capture::FileHeader))
+    {
+        std::cerr << "ERROR: " << capturePath << " is too short to be a capture file!\n";
+        close(fileDescriptor);
+        return false;
+    }
+
+    mappingSize_ = fileStatus.st_size;
+    void *mapping = mmap(nullptr, mappingSize_, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "ERROR: failed to map capture file " << capturePath << " (" << std::strerror(errno) << ")!\n";
+        return false;
+    }
+    mapping_ = static_cast<const char*>(mapping);
+
+    capture::FileHeader header;
+    std::memcpy(&header, mapping_, sizeof header);
+    if (!capture::isValidFileHeader(header))
+    {
+        std::cerr << "ERROR: " << capturePath << " is not a capture file of this echo server version!\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool CaptureReplay::indexRecords()
+{
+    // client is identified by protocol, ip and port it was captured with
+    std::map<uint64_t, std::size_t> streamIndices;
+    auto offset = sizeof(capture::FileHeader);
+    auto firstRecord = true;
+
+    while (offset + sizeof(capture::RecordHeader) <= mappingSize_)
+    {
+        capture::RecordHeader header;
+        std::memcpy(&header, mapping_ + offset, sizeof header);
+        if (offset + sizeof header + header.payloadSize > mappingSize_)
+            break;
+
+        if (firstRecord || header.timestampNs < firstTimestampNs_)
+            firstTimestampNs_ = header.timestampNs;
+        firstRecord = false;
+
+        const auto key = (static_cast<uint64_t>(header.protocol) << 48) |
+                         (static_cast<uint64_t>(header.clientIp) << 16) | header.clientPort;
+        const auto found = streamIndices.find(key);
+        if (found == streamIndices.end())
+        {
+            streamIndices.emplace(key, streams_.size());
+            ClientStream stream;
+            stream.protocol = static_cast<capture::Protocol>(header.protocol);
+            stream.clientIp = header.clientIp;
+            stream.clientPort = header.clientPort;
+            stream.records.push_back(offset);
+            streams_.push_back(std::move(stream));
+        }
+        else
+        {
+            streams_[found->second].records.push_back(offset);
+        }
+
+        offset += sizeof header + header.payloadSize;
+    }
+
+    // server stopped in the middle of a write leaves an incomplete record at the end of file
+    if (offset != mappingSize_)
+        std::cerr << "WARNING: capture file ends with an incomplete record, " << mappingSize_ - offset << " bytes skipped.\n";
+
+    if (streams_.empty())
+    {
+        std::cerr << "ERROR: capture file holds no messages!\n";
+        return false;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------
+
+void CaptureReplay::replayStream(const ClientStream &stream, std::chrono::steady_clock::time_point start)
+{
+    std::unique_ptr<BaseSender> sender;
+    if (stream.protocol == capture::Protocol::TCP)
+        sender.reset(new TcpSender(serverIp_, serverPort_, globals::defaultBufferSize));
+    else
+        sender.reset(new UdpSender(serverIp_, serverPort_, globals::defaultBufferSize));
+
+    if (!sender->isInitialized() || !sender->connectToServer())
+    {
+        failedMessages_ += stream.records.size();
+        return;
+    }
+    // lost UDP datagram must not stall the rest of the client's messages; its echo arriving later
+    // is told apart from the following echoes by UdpSender::exchange()
+    sender->setReceiveTimeout(replayReceiveTimeoutMs);
+
+    std::string response;
+    for (const auto offset : stream.records)
+    {
+        capture::RecordHeader header;
+        std::memcpy(&header, mapping_ + offset, sizeof header);
+        const char *payload = mapping_ + offset + sizeof header;
+
+        if (speed_ != maximumReplaySpeed)
+        {
+            const auto due = start + std::chrono::nanoseconds(
+                                 static_cast<int64_t>((header.timestampNs - firstTimestampNs_) / speed_));
+            std::this_thread::sleep_until(due);
+
+            const int64_t lag = std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - due).count();
+            auto maxLag = maxLagMicroseconds_.load();
+            while (lag > maxLag && !maxLagMicroseconds_.compare_exchange_weak(maxLag, lag)) {}
+        }
+
+        if (!sender->exchange(payload, header.payloadSize, response))
+        {
+            ++failedMessages_;
+            continue;
+        }
+
+        ++sentMessages_;
+        sentBytes_ += header.payloadSize;
+        if (response.size() != header.payloadSize || std::memcmp(response.data(), payload, header.payloadSize) != 0)
+            ++mismatchedEchoes_;
+    }
+}
+
+void CaptureReplay::run()
+{
+    if (!isInitialized_)
+    {
+        std::cerr << "ERROR: unable to replay capture file that wasn't loaded properly.\n";
+        return;
+    }
+
+    std::size_t messagesCount = 0;
+    for (const auto &stream : streams_)
+        messagesCount += stream.records.size();
+
+    std::cout << ">>> Replaying " << messagesCount << " messages of " << streams_.size() << " clients to EchoServer@"
+              << serverIp_ << ":" << serverPort_ << " at ";
+    if (speed_ == maximumReplaySpeed)
+        std::cout << "maximum speed.\n";
+    else
+        std::cout << speed_ << "x recorded speed.\n";
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(streams_.size());
+    for (const auto &stream : streams_)
+        threads.emplace_back(&CaptureReplay::replayStream, this, std::cref(stream), start);
+    for (auto &thread : threads)
+        thread.join();
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << ">>> Replayed " << sentMessages_ << " messages (" << sentBytes_ << " bytes) in "
+              << elapsed * 1000.0 << " ms, " << (elapsed > 0.0 ? sentMessages_ / elapsed : 0.0) << " messages/s.\n"
+              << ">>> Failed: " << failedMessages_ << ", echo mismatches: " << mismatchedEchoes_;
+    if (speed_ != maximumReplaySpeed)
+        std::cout << ", max lag behind schedule: " << maxLagMicroseconds_ << " us";
+    std::cout << ".\n";
+}
+
+}
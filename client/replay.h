@@ -0,0 +1,81 @@
+#ifndef INCLUDE_ONCE_9C41D7E2_3F08_4B5A_8E16_A27D50C3B9F4
+#define INCLUDE_ONCE_9C41D7E2_3F08_4B5A_8E16_A27D50C3B9F4
+
+#include "capturefile.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace echoclient
+{
+
+constexpr auto maximumReplaySpeed = 0.0;    /// < replay speed that sends every message as soon as the previous one is echoed
+
+/// @brief replays capture file written by 'echoServer --capture' against an EchoServer: every captured client
+///        gets its own sender (TCP connection or UDP socket) and thread, which sends the client's messages
+///        at their recorded time and waits for the echo of each one
+class CaptureReplay
+{
+public:
+    /// @brief CaptureReplay class constructor, maps the capture file into memory and indexes its records
+    /// @param capturePath capture file to replay
+    /// @param serverIp string containing ip v4 address of echoServer to replay messages to
+    /// @param serverPort port number of echoServer to replay messages to
+    /// @param speed how many times faster than recorded messages are sent, maximumReplaySpeed - without pauses
+    CaptureReplay(const std::string &capturePath, const std::string &serverIp, uint16_t serverPort, double speed);
+    /// @brief CaptureReplay class destructor
+    ~CaptureReplay();
+
+    /// @brief tells, whether the capture file was mapped and indexed successfully
+    /// @returns true if capture can be replayed, false - otherwise
+    bool isInitialized() const { return isInitialized_; }
+    /// @brief replays all captured messages and prints replay statistics
+    void run();
+
+private:
+    /// @brief messages of a single captured client
+    struct ClientStream
+    {
+        capture::Protocol protocol;             /// < protocol the client used
+        uint32_t clientIp;                      /// < client's recorded ip v4 address, network byte order
+        uint16_t clientPort;                    /// < client's recorded port, network byte order
+        std::vector<std::size_t> records;       /// < offsets of the client's records within the mapped file
+    };
+
+    /// @brief maps capture file into memory
+    /// @param capturePath capture file to replay
+    /// @returns true if file was mapped and has a valid header, false - otherwise
+    bool mapFile(const std::string &capturePath);
+    /// @brief splits records of the mapped file into client streams
+    /// @returns true if file holds at least one record, false - otherwise
+    bool indexRecords();
+    /// @brief sends messages of a single client, run in its own thread
+    /// @param stream client's messages
+    /// @param start moment the replay started
+    void replayStream(const ClientStream &stream, std::chrono::steady_clock::time_point start);
+
+    std::string serverIp_;                      /// < ip v4 address of echoServer messages are replayed to
+    uint16_t serverPort_;                       /// < port number of echoServer messages are replayed to
+    double speed_;                              /// < replay speed factor, maximumReplaySpeed - no pauses
+
+    const char *mapping_ = nullptr;             /// < capture file mapped into memory
+    std::size_t mappingSize_ = 0;               /// < size of the mapped file
+    uint64_t firstTimestampNs_ = 0;             /// < timestamp of the earliest record, replay time origin
+    std::vector<ClientStream> streams_;         /// < captured clients in order of their first message
+
+    std::atomic<uint64_t> sentMessages_;        /// < messages whose echo was received
+    std::atomic<uint64_t> sentBytes_;           /// < size of messages whose echo was received
+    std::atomic<uint64_t> failedMessages_;      /// < messages that couldn't be sent or got no echo
+    std::atomic<uint64_t> mismatchedEchoes_;    /// < echoes that differ from the sent message
+    std::atomic<int64_t> maxLagMicroseconds_;   /// < how late, at worst, a message was sent compared to the schedule
+
+    bool isInitialized_ = false;                /// < true if capture file was mapped and indexed successfully
+};
+
+}
+
+#endif // include guard
@@ -0,0 +1,71 @@
+#ifndef INCLUDE_ONCE_5A3E91C7_2B84_4D6F_A0E9_73C1D8F64B25
+#define INCLUDE_ONCE_5A3E91C7_2B84_4D6F_A0E9_73C1D8F64B25
+
+#include <cstdint>
+#include <cstring>
+
+// Capture file layout:
+//   FileHeader, then records one after another until the end of file,
+//   every record is a RecordHeader followed by payloadSize bytes of the message.
+// Numbers are stored in host byte order, client address and port - in network byte order as in sockaddr_in.
+// Records are not aligned, so they are read with memcpy.
+
+namespace capture
+{
+
+constexpr char fileMagic[8] = { 'E', 'C', 'H', 'O', 'C', 'A', 'P', '\0' };  /// < first bytes of every capture file
+constexpr uint32_t fileVersion = 1;                                         /// < version of the capture file layout
+
+/// @brief protocol the captured message was received by, values match echoclient::ClientProtocol
+enum class Protocol : uint8_t
+{
+    TCP = 0,
+    UDP = 1,
+};
+
+/// @brief header at the beginning of a capture file
+struct FileHeader
+{
+    char magic[8];                  /// < fileMagic
+    uint32_t version;               /// < fileVersion
+    uint32_t recordHeaderSize;      /// < sizeof(RecordHeader), guards against reading file of a different build
+};
+
+/// @brief header of a single captured message
+struct RecordHeader
+{
+    uint64_t timestampNs;           /// < when message was received, nanoseconds since the Unix epoch
+    uint32_t clientIp;              /// < client's ip v4 address
+    uint16_t clientPort;            /// < client's port
+    uint8_t protocol;               /// < Protocol
+    uint8_t reserved;               /// < always 0
+    uint32_t payloadSize;           /// < size of the message following the header
+    uint32_t reserved2;             /// < always 0, keeps the header free of implicit padding
+};
+
+static_assert(sizeof(FileHeader) == 16, "capture file header layout changed");
+static_assert(sizeof(RecordHeader) == 24, "capture record header layout changed");
+
+/// @brief makes header for a new capture file
+/// @returns file header
+inline FileHeader makeFileHeader()
+{
+    FileHeader header;
+    std::memcpy(header.magic, fileMagic, sizeof header.magic);
+    header.version = fileVersion;
+    header.recordHeaderSize = sizeof(RecordHeader);
+    return header;
+}
+
+/// @brief checks whether file header was written by a compatible capture writer
+/// @param header header read from the file
+/// @returns true if records of the file can be read, false - otherwise
+inline bool isValidFileHeader(const FileHeader &header)
+{
+    return std::memcmp(header.magic, fileMagic, sizeof header.magic) == 0 && header.version == fileVersion &&
+           header.recordHeaderSize == sizeof(RecordHeader);
+}
+
+}
+
+#endif // include guard
@@ -30,6 +30,11 @@ constexpr auto failureToConnectCode = -1;       /// < socket failed to connect e
 constexpr auto failureToParseIpCode = -1;       /// < return value of inet_pton method when it can't parse ip from text
 constexpr auto disconnectionMsgLength = 0;      /// < length of message that signals client disconnection
 
+constexpr auto udpSegmentOption = 103;          /// < UDP_SEGMENT socket option (GSO segment size), missing from older glibc headers
+constexpr auto udpGroOption = 104;              /// < UDP_GRO socket option (receive coalesced datagrams), missing from older glibc headers
+constexpr auto maxGsoSegments = 64;             /// < maximum number of segments kernel accepts in one GSO send
+constexpr auto maxUdpPayloadSize = 65507;       /// < maximum payload size of a single ip v4 UDP datagram
+
 }
 
 #endif // include guard
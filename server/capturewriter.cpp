@@ -0,0 +1,198 @@
+#include "capturewriter.h"
+#include "tracing.h"
+
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+namespace echoserver
+{
+
+namespace
+{
+
+constexpr std::size_t flushThreshold = 256 * 1024;              /// < buffered bytes that wake up the writing thread
+constexpr std::size_t maxBufferedBytes = 64 * 1024 * 1024;      /// < buffered bytes above which new messages are dropped
+constexpr auto flushInterval = std::chrono::milliseconds(100);  /// < how often a partially filled buffer is written
+
+}
+
+//---------------------------------------------------------
+
+CaptureWriter::CaptureWriter(const std::string &path)
+{
+    if (path.empty() || !openFile(path))
+        return;
+
+    // reserved up front, so listeners don't reallocate the buffer while holding the lock
+    activeBuffer_.reserve(2 * flushThreshold);
+    writerThread_.reset(new std::thread(&CaptureWriter::run, this));
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    if (writerThread_)
+    {
+        {
+            std::lock_guard<std::mutex> lock(bufferMutex_);
+            stopping_ = true;
+        }
+        bufferReady_.notify_one();
+        writerThread_->join();
+    }
+
+    if (droppedMessages_ > 0)
+    {
+        std::cerr << "WARNING: " << droppedMessages_ << " messages were not captured, "
+                     "capture file couldn't be written fast enough.\n";
+    }
+
+    if (fileDescriptor_ >= 0)
+        close(fileDescriptor_);
+}
+
+//---------------------------------------------------------
+
+bool CaptureWriter::openFile(const std::string &path)
+{
+    // O_APPEND keeps records whole even when a reloaded server appends to the same file
+    // while the previous process is still writing its last buffers
+    fileDescriptor_ = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fileDescriptor_ < 0)
+    {
+        std::cerr << "ERROR: failed to open capture file " << path << " (" << std::strerror(errno) << ")!\n";
+        return false;
+    }
+
+    struct stat fileStatus;
+    if (fstat(fileDescriptor_, &fileStatus) != 0)
+    {
+        std::cerr << "ERROR: failed to stat capture file " << path << " (" << std::strerror(errno) << ")!\n";
+        close(fileDescriptor_);
+        fileDescriptor_ = -1;
+        return false;
+    }
+
+    if (fileStatus.st_size == 0)
+    {
+        const auto header = capture::makeFileHeader();
+        if (!writeBuffer(std::string(reinterpret_cast<const char*>(&header), sizeof header)))
+        {
+            std::cerr << "ERROR: failed to write capture file header to " << path << "!\n";
+            close(fileDescriptor_);
+            fileDescriptor_ = -1;
+            return false;
+        }
+        return true;
+    }
+
+    capture::FileHeader header;
+    if (pread(fileDescriptor_, &header, sizeof header, 0) != sizeof header || !capture::isValidFileHeader(header))
+    {
+        std::cerr << "ERROR: " << path << " exists and is not a capture file of this echo server version, "
+                     "refusing to append to it!\n";
+        close(fileDescriptor_);
+        fileDescriptor_ = -1;
+        return false;
+    }
+
+    return true;
+}
+
+bool CaptureWriter::writeBuffer(const std::string &buffer)
+{
+    std::size_t written = 0;
+    while (written < buffer.size())
+    {
+        const auto wSize = ::write(fileDescriptor_, buffer.data() + written, buffer.size() - written);
+        if (wSize < 0 && errno == EINTR)
+            continue;
+        if (wSize <= 0)
+            return false;
+        written += wSize;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------
+
+void CaptureWriter::write(capture::Protocol protocol, const std::string &message, const sockaddr_in &clientAddress)
+{
+    ECHO_TRACE_SCOPE("capture");
+    capture::RecordHeader header;
+    header.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch()).count();
+    header.clientIp = clientAddress.sin_addr.s_addr;
+    header.clientPort = clientAddress.sin_port;
+    header.protocol = static_cast<uint8_t>(protocol);
+    header.reserved = 0;
+    header.payloadSize = message.size();
+    header.reserved2 = 0;
+
+    auto wakeWriter = false;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex_);
+        if (activeBuffer_.size() + sizeof header + message.size() > maxBufferedBytes)
+        {
+            ++droppedMessages_;
+            return;
+        }
+
+        const auto sizeBefore = activeBuffer_.size();
+        activeBuffer_.append(reinterpret_cast<const char*>(&header), sizeof header);
+        activeBuffer_.append(message);
+        // writer is woken up once per filled buffer, not for every message
+        wakeWriter = sizeBefore < flushThreshold && activeBuffer_.size() >= flushThreshold;
+    }
+
+    if (wakeWriter)
+        bufferReady_.notify_one();
+}
+
+void CaptureWriter::run()
+{
+    // writer is started before the server blocks signals, signals it waits for must reach the server's signal thread
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    std::string writingBuffer;
+    writingBuffer.reserve(2 * flushThreshold);
+
+    auto stopping = false;
+    while (!stopping)
+    {
+        {
+            std::unique_lock<std::mutex> lock(bufferMutex_);
+            bufferReady_.wait_for(lock, flushInterval, [this]() {
+                return stopping_ || activeBuffer_.size() >= flushThreshold;
+            });
+            stopping = stopping_;
+            // listeners continue with the emptied spare buffer while this one is written without the lock
+            activeBuffer_.swap(writingBuffer);
+        }
+
+        if (writingBuffer.empty())
+            continue;
+
+        if (!writeBuffer(writingBuffer))
+        {
+            std::cerr << "ERROR: failed to write capture file (" << std::strerror(errno) << "), "
+                      << writingBuffer.size() << " bytes of captured messages are lost!\n";
+        }
+        writingBuffer.clear();
+    }
+}
+
+}
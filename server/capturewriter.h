@@ -0,0 +1,62 @@
+#ifndef INCLUDE_ONCE_E27B4C09_6D1A_4F83_9C5E_0B8A3F71D264
+#define INCLUDE_ONCE_E27B4C09_6D1A_4F83_9C5E_0B8A3F71D264
+
+#include "capturefile.h"
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <memory>
+#include <cstdint>
+#include <condition_variable>
+#include <netinet/in.h>
+
+namespace echoserver
+{
+
+/// @brief appends received messages to a capture file (see capturefile.h); listeners only copy messages into
+///        a memory buffer, a background thread swaps it with a second buffer and writes it to the file
+class CaptureWriter
+{
+public:
+    /// @brief CaptureWriter class constructor, opens the file and starts the writing thread
+    /// @param path capture file, existing capture file is appended to; empty path disables capture
+    explicit CaptureWriter(const std::string &path);
+    /// @brief CaptureWriter class destructor, writes remaining messages and closes the file
+    ~CaptureWriter();
+
+    /// @brief tells, whether the capture file was opened successfully
+    /// @returns true if messages are captured, false - otherwise
+    bool isInitialized() const { return fileDescriptor_ >= 0; }
+    /// @brief queues message for writing; safe to call from any thread, never waits for the disk
+    /// @param protocol protocol the message was received by
+    /// @param message text of the message
+    /// @param clientAddress client's address data
+    void write(capture::Protocol protocol, const std::string &message, const sockaddr_in &clientAddress);
+
+private:
+    /// @brief opens capture file, writes file header to a new file or checks header of an existing one
+    /// @param path capture file
+    /// @returns true if records can be appended to the file, false - otherwise
+    bool openFile(const std::string &path);
+    /// @brief writes queued messages to the file until the writer is destroyed
+    void run();
+    /// @brief writes whole buffer to the file
+    /// @param buffer data to write
+    /// @returns true if everything was written, false - otherwise
+    bool writeBuffer(const std::string &buffer);
+
+    int fileDescriptor_ = -1;                   /// < descriptor of the capture file
+
+    std::mutex bufferMutex_;                    /// < guards activeBuffer_, stopping_ and droppedMessages_
+    std::condition_variable bufferReady_;       /// < notified when activeBuffer_ is worth writing or writer stops
+    std::string activeBuffer_;                  /// < buffer listeners append records to
+    bool stopping_ = false;                     /// < true once the writer is being destroyed
+    uint64_t droppedMessages_ = 0;              /// < messages not captured because the disk couldn't keep up
+
+    std::unique_ptr<std::thread> writerThread_; /// < thread that writes buffers to the file
+};
+
+}
+
+#endif // include guard
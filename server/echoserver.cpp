@@ -1,13 +1,264 @@
 #include "echoserver.h"
+#include "tracing.h"
 
+#include <chrono>
+#include <vector>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <algorithm>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
 
 namespace echoserver
 {
 
-EchoServer::EchoServer(uint16_t port, uint32_t bufferSize)
-    : tcpListener_(port, bufferSize)
-    , udpListener_(port, bufferSize) {}
+namespace
+{
+
+constexpr auto successorReadyTimeoutMs = 10000;     /// < how long reloading server waits for its successor to start serving
+
+}
+
+EchoServer::EchoServer(const ServerOptions &options)
+    : capture_(options.captureFile)
+    , numbersPool_(options.parallelThreshold > 0 ? new WorkerPool(options.parallelThreads, options.workerCpus) : nullptr)
+    , tcpListener_(options, capture_.isInitialized() ? &capture_ : nullptr, numbersPool_.get())
+    , udpListener_(options, capture_.isInitialized() ? &capture_ : nullptr, numbersPool_.get())
+    , options_(options)
+    , stopped_(false)
+    , finished_(false) {}
+
+void EchoServer::printPlacement(const std::string &threadName, int cpu) const
+{
+    if (cpu == anyCpu)
+        return;
+
+    std::cout << ">>> " << threadName << " pinned to cpu " << cpu;
+    const auto node = numaNodeOfCpu(cpu);
+    if (node != unknownNumaNode)
+        std::cout << " (NUMA node " << node << ")";
+    std::cout << ".\n";
+}
+
+void EchoServer::stopListeners()
+{
+    stopped_ = true;
+    tcpListener_.stop();
+    udpListener_.stop();
+}
+
+bool EchoServer::startSuccessor()
+{
+    if (options_.executablePath.empty() || options_.commandLine.empty())
+    {
+        std::cerr << "ERROR: server executable is unknown, can't start a successor!\n";
+        return false;
+    }
+
+    const auto tcpDescriptor = tcpListener_.isInitialized() ? tcpListener_.getSocketDescriptor() : -1;
+    const auto udpDescriptor = udpListener_.isInitialized() ? udpListener_.getSocketDescriptor() : -1;
+
+    // successor reports through this socket once its listeners serve clients; socket rather than pipe,
+    // so the report can be sent with MSG_NOSIGNAL
+    int readySockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, readySockets) != 0)
+    {
+        std::cerr << "ERROR: failed to create readiness socket for the successor process (" << std::strerror(errno) << ")!\n";
+        return false;
+    }
+
+    // successor gets the same arguments, except for descriptors this process has inherited itself
+    std::vector<std::string> arguments;
+    for (std::size_t i = 0; i < options_.commandLine.size(); ++i)
+    {
+        if (options_.commandLine[i] == inheritSocketsOption)
+            ++i;
+        else
+            arguments.push_back(options_.commandLine[i]);
+    }
+    arguments.push_back(inheritSocketsOption);
+    arguments.push_back(std::to_string(tcpDescriptor) + "," + std::to_string(udpDescriptor) + "," +
+                        std::to_string(readySockets[1]));
+
+    std::vector<char*> argv;
+    for (auto &argument : arguments)
+        argv.push_back(&argument[0]);
+    argv.push_back(nullptr);
+
+    // the pipe is closed by successful exec, otherwise child writes errno into it
+    int statusPipe[2];
+    if (pipe2(statusPipe, O_CLOEXEC) != 0)
+    {
+        std::cerr << "ERROR: failed to create pipe for the successor process (" << std::strerror(errno) << ")!\n";
+        close(readySockets[0]);
+        close(readySockets[1]);
+        return false;
+    }
+
+    const auto pid = fork();
+    if (pid < 0)
+    {
+        std::cerr << "ERROR: failed to fork the successor process (" << std::strerror(errno) << ")!\n";
+        close(statusPipe[0]);
+        close(statusPipe[1]);
+        close(readySockets[0]);
+        close(readySockets[1]);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        // only async-signal-safe calls from here to exec
+        sigset_t noSignals;
+        sigemptyset(&noSignals);
+        sigprocmask(SIG_SETMASK, &noSignals, nullptr);
+        if (tcpDescriptor >= 0)
+            fcntl(tcpDescriptor, F_SETFD, 0);
+        if (udpDescriptor >= 0)
+            fcntl(udpDescriptor, F_SETFD, 0);
+        fcntl(readySockets[1], F_SETFD, 0);
+
+        execv(options_.executablePath.c_str(), argv.data());
+
+        const int execError = errno;
+        const auto written = write(statusPipe[1], &execError, sizeof execError);
+        static_cast<void>(written);
+        _exit(EXIT_FAILURE);
+    }
+
+    close(statusPipe[1]);
+    close(readySockets[1]);
+    int execError = 0;
+    const auto rSize = read(statusPipe[0], &execError, sizeof execError);
+    close(statusPipe[0]);
+
+    if (rSize > 0)
+    {
+        std::cerr << "ERROR: failed to start the successor process " << options_.executablePath
+                  << " (" << std::strerror(execError) << ")!\n";
+        close(readySockets[0]);
+        waitpid(pid, nullptr, 0);
+        return false;
+    }
+
+    const auto ready = waitForSuccessor(pid, readySockets[0]);
+    close(readySockets[0]);
+    if (!ready)
+        return false;
+
+    std::cout << ">>> Started successor process " << pid << ", listening sockets are handed over to it.\n";
+    return true;
+}
+
+bool EchoServer::waitForSuccessor(pid_t pid, int readyDescriptor)
+{
+    // this process keeps serving meanwhile, so the port never goes without listeners
+    pollfd descriptor;
+    descriptor.fd = readyDescriptor;
+    descriptor.events = POLLIN;
+    descriptor.revents = 0;
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(successorReadyTimeoutMs);
+    auto polled = 0;
+    while (true)
+    {
+        const auto timeLeft = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                  deadline - std::chrono::steady_clock::now()).count();
+        polled = poll(&descriptor, 1, std::max<int>(static_cast<int>(timeLeft), 0));
+        if (polled >= 0 || errno != EINTR)
+            break;
+    }
+
+    char report = 0;
+    if (polled > 0 && recv(readyDescriptor, &report, sizeof report, 0) == sizeof report)
+        return true;
+
+    // successor that closed the socket without a report failed to start its listeners or exited; one that stays
+    // silent is stuck - either way it must not keep sharing the listening sockets
+    if (polled > 0)
+    {
+        std::cerr << "ERROR: successor process " << pid << " failed to start serving!\n";
+        kill(pid, SIGTERM);
+    }
+    else
+    {
+        std::cerr << "ERROR: successor process " << pid << " didn't start serving within "
+                  << successorReadyTimeoutMs << " ms!\n";
+        kill(pid, SIGKILL);
+    }
+    waitpid(pid, nullptr, 0);
+    return false;
+}
+
+void EchoServer::reportReadiness()
+{
+    // previous process drains only after this report, so a successor that failed to start doesn't leave
+    // the port without listeners; closing the socket without a report tells it the reload failed
+    const auto started = (!tcpListenerThread_ || tcpListener_.waitUntilStarted()) &&
+                         (!udpListenerThread_ || udpListener_.waitUntilStarted());
+    if (started)
+    {
+        const char report = 1;
+        if (send(options_.readyDescriptor, &report, sizeof report, MSG_NOSIGNAL) != sizeof report)
+            std::cerr << "WARNING: failed to report readiness to the previous server process (" << std::strerror(errno) << ").\n";
+    }
+    close(options_.readyDescriptor);
+}
+
+void EchoServer::handleSignals(sigset_t signals)
+{
+    while (true)
+    {
+        int signal = 0;
+        if (sigwait(&signals, &signal) != 0)
+            continue;
+        if (finished_)
+            return;
+
+        switch (signal)
+        {
+        case SIGHUP:
+            if (stopped_)
+            {
+                std::cout << ">>> Echo server is already stopping, SIGHUP is ignored.\n";
+                break;
+            }
+            if (!startSuccessor())
+            {
+                std::cerr << "Reload failed, echo server keeps running.\n";
+                break;
+            }
+            std::cout << ">>> Draining echo server before exit.\n";
+            stopListeners();
+            break;
+        case SIGUSR1:
+#ifdef ECHOSERVER_TRACING
+            if (tracing::dump(options_.traceFile))
+                std::cout << ">>> Trace written to " << options_.traceFile << ".\n";
+            else
+                std::cerr << "ERROR: failed to write trace to " << options_.traceFile << "!\n";
+#endif
+            break;
+        default:
+            if (stopped_)
+            {
+                // impatient second request doesn't wait for the drain to finish
+                std::cerr << "Echo server is terminated without finishing the drain.\n";
+                _exit(EXIT_FAILURE);
+            }
+            std::cout << ">>> Stopping echo server, draining for up to " << options_.drainTimeoutMs << " ms.\n";
+            stopListeners();
+            break;
+        }
+    }
+}
 
 void EchoServer::run()
 {
@@ -18,18 +269,61 @@ void EchoServer::run()
         return;
     }
 
+    if (!options_.captureFile.empty() && !capture_.isInitialized())
+    {
+        std::cerr << "Capture file can't be written. Echo server can't be run. EXIT.\n";
+        return;
+    }
+
     // both tcp and udp listeners use same port, so it doesn't really matter which one we call getPort() from
-    std::cout << ">>> Running echo server on port " << tcpListener_.getPort() << ".\n\n";
+    std::cout << ">>> Running echo server on port " << tcpListener_.getPort() << ".\n";
+    printPlacement("TCP listener", options_.tcpListenerCpu);
+    printPlacement("UDP listener", options_.udpListenerCpu);
+    for (const auto cpu : options_.workerCpus)
+        printPlacement("TCP connection worker", cpu);
+    if (capture_.isInitialized())
+        std::cout << ">>> Capturing received messages to " << options_.captureFile << ".\n";
+
+    // signals are blocked before any other thread is created, so all threads inherit the mask and
+    // only the signal thread receives them through sigwait()
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    if (!options_.traceFile.empty())
+    {
+#ifdef ECHOSERVER_TRACING
+        sigaddset(&signals, SIGUSR1);
+        std::cout << ">>> Send SIGUSR1 to write trace to " << options_.traceFile << ".\n";
+#else
+        std::cerr << "WARNING: echo server was built without ECHOSERVER_TRACING, trace file won't be written.\n";
+#endif
+    }
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    std::cout << ">>> Send SIGTERM to stop, SIGHUP to restart; connected clients are served for up to "
+              << options_.drainTimeoutMs << " ms more, until they disconnect.\n\n";
+
+    signalThread_.reset(new std::thread(&EchoServer::handleSignals, this, signals));
 
     if (tcpListener_.isInitialized())
         tcpListenerThread_.reset(new std::thread(&TcpListener::run, &tcpListener_));
     if (udpListener_.isInitialized())
         udpListenerThread_.reset(new std::thread(&UdpListener::run, &udpListener_));
+    if (options_.readyDescriptor >= 0)
+        reportReadiness();
 
     if (tcpListenerThread_)
         tcpListenerThread_->join();
     if (udpListenerThread_)
         udpListenerThread_->join();
+
+    // signal thread keeps waiting for signals until here, so it gets one more to notice the shutdown is complete
+    finished_ = true;
+    pthread_kill(signalThread_->native_handle(), SIGTERM);
+    signalThread_->join();
+
+    std::cout << ">>> Echo server stopped.\n";
 }
 
 }
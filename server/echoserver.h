@@ -3,8 +3,12 @@
 
 #include "listeners.h"
 
+#include <atomic>
+#include <string>
 #include <thread>
 #include <memory>
+#include <signal.h>
+#include <sys/types.h>
 
 namespace echoserver
 {
@@ -14,18 +18,47 @@ class EchoServer
 {
 public:
     /// @brief EchoServer class constructor
-    /// @param port port to which the EchoServer will be listening to
-    /// @param bufferSize size of the read buffers
-    EchoServer(uint16_t port, uint32_t bufferSize);
-    /// @brief runs the EchoServer
+    /// @param options server settings: port to which the EchoServer will be listening to,
+    ///        size of the read buffers and optional listener features
+    explicit EchoServer(const ServerOptions &options);
+    /// @brief runs the EchoServer until SIGINT / SIGTERM / SIGHUP drains it
     void run();
 
 private:
+    /// @brief prints, which core and NUMA node thread is placed on
+    /// @param threadName name of the thread for the message
+    /// @param cpu core the thread is pinned to, or anyCpu
+    void printPlacement(const std::string &threadName, int cpu) const;
+    /// @brief waits for signals until the server is shut down: SIGINT / SIGTERM stop the server and, received again
+    ///        while it is draining, terminate the process at once; SIGHUP hands listening sockets over to
+    ///        a new server process and then stops this one, SIGUSR1 writes trace file
+    /// @param signals set of signals blocked in all threads of the server
+    void handleSignals(sigset_t signals);
+    /// @brief starts new server process with the same arguments that takes over listening sockets
+    /// @returns true if the new process was started, false - otherwise
+    bool startSuccessor();
+    /// @brief waits until a started successor reports that it serves clients, stops the successor if it doesn't
+    /// @param pid successor's process id
+    /// @param readyDescriptor socket the successor reports through
+    /// @returns true if successor reported it serves clients, false - otherwise
+    bool waitForSuccessor(pid_t pid, int readyDescriptor);
+    /// @brief tells the previous server process whether listeners started serving clients, closes options.readyDescriptor
+    void reportReadiness();
+    /// @brief makes listeners stop accepting clients and finish already received messages
+    void stopListeners();
+
+    CaptureWriter capture_;                             /// < writes received messages to the capture file, created before listeners
+    std::unique_ptr<WorkerPool> numbersPool_;           /// < threads shared by listeners for large messages, created before listeners
     TcpListener tcpListener_;                           /// < listener for TCP protocol
     UdpListener udpListener_;                           /// < listener for UDP protocol
 
     std::unique_ptr<std::thread> tcpListenerThread_;    /// < thread in which the TCP listener is run
     std::unique_ptr<std::thread> udpListenerThread_;    /// < thread in which the UDP listener is run
+    std::unique_ptr<std::thread> signalThread_;         /// < thread that handles shutdown, reload and trace signals
+
+    ServerOptions options_;                             /// < settings the EchoServer was created with
+    std::atomic<bool> stopped_;                         /// < true once listeners were told to stop
+    std::atomic<bool> finished_;                        /// < true once listeners have returned, ends the signal thread
 };
 
 }
@@ -1,35 +1,162 @@
 #include "listeners.h"
 #include "globals.h"
+#include "tracing.h"
+#include "numberformatter.h"
+#include "messagenumbers.h"
+#include "threadplacement.h"
 
-#include <regex>
+#include <chrono>
 #include <thread>
+#include <cerrno>
 #include <cstring>
-#include <numeric>
+#include <vector>
 #include <iostream>
 #include <stdlib.h>
 #include <unistd.h>
 #include <algorithm>
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <poll.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
 
 namespace echoserver
 {
 
 //---------------------------------------------------------
 
-BaseListener::BaseListener(uint16_t port, uint32_t bufferSize)
-    : bufferSize_(bufferSize)
+BaseListener::BaseListener(const ServerOptions &options, CaptureWriter *capture, WorkerPool *numbersPool)
+    : bufferSize_(options.bufferSize)
+    , options_(options)
+    , capture_(capture)
+    , numbersPool_(numbersPool)
+    , stopping_(false)
 {
     std::memset(&socketAddress_, 0x00, sizeof socketAddress_);
     socketAddress_.sin_family = AF_INET;
     socketAddress_.sin_addr.s_addr = htonl(INADDR_ANY);
-    socketAddress_.sin_port = htons(port);
+    socketAddress_.sin_port = htons(options.port);
+
+    stopDescriptor_ = eventfd(0, EFD_CLOEXEC);
+    if (stopDescriptor_ < 0)
+        std::cerr << "WARNING: failed to create stop event (" << std::strerror(errno) << "), listener can't be stopped.\n";
 }
 
 BaseListener::~BaseListener()
 {
-    close(socketDescriptor_);
+    if (socketDescriptor_ >= 0)
+        close(socketDescriptor_);
+    if (stopDescriptor_ >= 0)
+        close(stopDescriptor_);
+}
+
+//---------------------------------------------------------
+
+void BaseListener::stop()
+{
+    std::lock_guard<std::mutex> lock(stopMutex_);
+    if (stopping_)
+        return;
+
+    drainDeadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.drainTimeoutMs);
+    stopping_.store(true, std::memory_order_release);
+
+    // eventfd stays readable from now on, waking every thread that polls it
+    const uint64_t signal = 1;
+    if (write(stopDescriptor_, &signal, sizeof signal) != sizeof signal)
+        std::cerr << "ERROR: failed to signal listener to stop (" << std::strerror(errno) << ")!\n";
+}
+
+bool BaseListener::waitUntilStarted()
+{
+    std::unique_lock<std::mutex> lock(startMutex_);
+    startChanged_.wait(lock, [this]() { return startReported_; });
+    return started_;
+}
+
+void BaseListener::reportStarted(bool started)
+{
+    std::lock_guard<std::mutex> lock(startMutex_);
+    startReported_ = true;
+    started_ = started;
+    startChanged_.notify_all();
+}
+
+bool BaseListener::drainTimedOut() const
+{
+    return stopping_.load(std::memory_order_acquire) && std::chrono::steady_clock::now() >= drainDeadline_;
+}
+
+bool BaseListener::waitForData(int descriptor) const
+{
+    pollfd descriptors[2];
+    descriptors[0].fd = descriptor;
+    descriptors[0].events = POLLIN;
+    descriptors[1].fd = stopDescriptor_;
+    descriptors[1].events = POLLIN;
+
+    while (true)
+    {
+        // once stopping, only data that is already queued is taken
+        const auto stopping = stopping_.load(std::memory_order_acquire);
+        descriptors[0].revents = 0;
+        descriptors[1].revents = 0;
+
+        const auto ready = poll(descriptors, stopping ? 1 : 2, stopping ? 0 : -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        // readable, hung up or failed - recv() will tell which one
+        if (descriptors[0].revents != 0)
+            return !drainTimedOut();
+        if (stopping)
+            return false;
+    }
+}
+
+bool BaseListener::waitForClient(int descriptor) const
+{
+    pollfd descriptors[2];
+    descriptors[0].fd = descriptor;
+    descriptors[0].events = POLLIN;
+    descriptors[1].fd = stopDescriptor_;
+    descriptors[1].events = POLLIN;
+
+    while (true)
+    {
+        // once stopping, client still has until the drain deadline to send more or disconnect
+        const auto stopping = stopping_.load(std::memory_order_acquire);
+        auto timeout = -1;
+        if (stopping)
+        {
+            const auto timeLeft = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                      drainDeadline_ - std::chrono::steady_clock::now()).count();
+            if (timeLeft <= 0)
+                return false;
+            timeout = static_cast<int>(timeLeft);
+        }
+        descriptors[0].revents = 0;
+        descriptors[1].revents = 0;
+
+        const auto ready = poll(descriptors, stopping ? 1 : 2, timeout);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        // readable, hung up or failed - recv() will tell which one
+        if (descriptors[0].revents != 0)
+            return !drainTimedOut();
+    }
 }
 
 //---------------------------------------------------------
@@ -37,7 +164,8 @@ BaseListener::~BaseListener()
 bool BaseListener::prepareSocket(int type, int protocol, const std::string &typeString)
 {
     const auto socketSize = sizeof socketAddress_;
-    socketDescriptor_ = socket(PF_INET, type, protocol);
+    // close-on-exec, so only sockets deliberately handed over reach the successor process
+    socketDescriptor_ = socket(PF_INET, type | SOCK_CLOEXEC, protocol);
     if (socketDescriptor_ == globals::failureToInitCode)
     {
         std::cerr << "ERROR: failed to create a " << typeString << " socket!\n";
@@ -49,155 +177,743 @@ bool BaseListener::prepareSocket(int type, int protocol, const std::string &type
         std::cerr << "ERROR: failed to bind a " << typeString << " socket to port "
                   << ntohs(socketAddress_.sin_port) << "!\n";
         close(socketDescriptor_);
+        socketDescriptor_ = -1;
+        return false;
+    }
+
+    return true;
+}
+
+bool BaseListener::adoptSocket(int descriptor, int type, const std::string &typeString)
+{
+    int actualType = 0;
+    socklen_t typeLength = sizeof actualType;
+    sockaddr_in boundAddress;
+    socklen_t addressLength = sizeof boundAddress;
+
+    if (getsockopt(descriptor, SOL_SOCKET, SO_TYPE, &actualType, &typeLength) != 0 || actualType != type
+            || getsockname(descriptor, reinterpret_cast<sockaddr*>(&boundAddress), &addressLength) != 0
+            || boundAddress.sin_family != AF_INET)
+    {
+        std::cerr << "ERROR: inherited descriptor " << descriptor << " is not a bound " << typeString << " socket!\n";
         return false;
     }
 
+    socketDescriptor_ = descriptor;
+    socketAddress_ = boundAddress;
+    fcntl(socketDescriptor_, F_SETFD, FD_CLOEXEC);
     return true;
 }
 
 //---------------------------------------------------------
 
-std::vector<int> extractNumbers(const std::string &message)
+namespace
 {
-    std::vector<int> numbers;
-    const std::regex numberRegex("-?\\d+");
-    const auto numBegin = std::sregex_iterator(message.begin(), message.end(), numberRegex);
-    const auto numEnd = std::sregex_iterator();
 
-    for (std::sregex_iterator i = numBegin; i != numEnd; ++i)
-        numbers.emplace_back( std::stoi((*i).str()) );
+const std::string numbersText = "Numbers within message: ";     /// < beginning of the message report
+const std::string minNumberText = "\nMin number: ";             /// < report text before minimal number
+const std::string maxNumberText = "; max number: ";             /// < report text before maximal number
+const std::string sumText = "\nSum of numbers: ";               /// < report text before sum of numbers
+const std::string reportEndText = "\n\n";                       /// < end of the message report
 
-    return numbers;
 }
 
 void BaseListener::processMessage(const std::string &message)
 {
-    auto numbers = extractNumbers(message);
+    ECHO_TRACE_SCOPE("processMessage");
+    // only large messages are worth handing to the pool
+    const auto useParallel = options_.parallelThreshold > 0 && message.size() >= options_.parallelThreshold;
+    std::vector<int> numbers;
+    auto sum = 0;
+    collectNumbers(message, useParallel ? numbersPool_ : nullptr, numbers, sum);
 
     if (!numbers.empty())
     {
-        std::sort(numbers.begin(), numbers.end(), [](int lhs, int rhs){ return rhs < lhs; });
-
-        const std::string numberList = std::accumulate(std::next(numbers.cbegin()), numbers.cend(),
-                                                       std::to_string(numbers.front()),
-                                                       [](std::string a, int b)
-                                                       {
-                                                           return std::move(a) + " " + std::to_string(b);
-                                                       });
-
-        std::cout << "Numbers within message: " << numberList <<  "\n";
-        std::cout << "Min number: " << numbers.back() << "; max number: " << numbers.front() << "\n";
-        std::cout << "Sum of numbers: " << std::accumulate(numbers.cbegin(), numbers.cend(), 0) << "\n";
+        // whole report is formatted into one per-thread buffer and handed to std::cout with a single write
+        ECHO_TRACE_BEGIN(formatTrace);
+        thread_local NumberFormatter report;
+        report.clear();
+        report.append(numbersText);
+        report.appendList(numbers);
+        report.append(minNumberText);
+        report.append(numbers.back());
+        report.append(maxNumberText);
+        report.append(numbers.front());
+        report.append(sumText);
+        report.append(sum);
+        report.append(reportEndText);
+        ECHO_TRACE_END(formatTrace, "format");
+
+        ECHO_TRACE_SCOPE("output");
+        std::cout.write(report.data(), report.size());
+        return;
     }
 
     std::cout << "\n";
 }
 
+void BaseListener::printMessage(const std::string &message, const sockaddr_in &clientAddress)
+{
+    ECHO_TRACE_SCOPE("printMessage");
+    std::cout << "Message from " << inet_ntoa(clientAddress.sin_addr) << ":"
+              << ntohs(clientAddress.sin_port) << ": " << message << "\n";
+}
+
+void BaseListener::captureMessage(capture::Protocol protocol, const std::string &message, const sockaddr_in &clientAddress)
+{
+    if (capture_)
+        capture_->write(protocol, message, clientAddress);
+}
+
 //=========================================================
 
-TcpListener::TcpListener(uint16_t port, uint32_t bufferSize)
-    : BaseListener(port, bufferSize)
+TcpListener::TcpListener(const ServerOptions &options, CaptureWriter *capture, WorkerPool *numbersPool)
+    : BaseListener(options, capture, numbersPool)
 {
-    isInitialized_ = prepareSocket(SOCK_STREAM, IPPROTO_TCP, "TCP");
+    if (options_.inheritedTcpDescriptor >= 0)
+        isInitialized_ = adoptSocket(options_.inheritedTcpDescriptor, SOCK_STREAM, "TCP");
+    else
+        isInitialized_ = prepareSocket(SOCK_STREAM, IPPROTO_TCP, "TCP");
 }
 
 //---------------------------------------------------------
 
-void TcpListener::handleConnection(int connectionSocket, sockaddr_in clientAddress)
+void TcpListener::handlerFinished()
 {
-    char *readBuffer = new char[bufferSize_];
-    while (true)
+    std::lock_guard<std::mutex> lock(handlersMutex_);
+    --activeHandlers_;
+    handlersFinished_.notify_all();
+}
+
+void TcpListener::waitForHandlers()
+{
+    std::unique_lock<std::mutex> lock(handlersMutex_);
+    const auto handlersFinished = [this]() { return activeHandlers_ == 0; };
+    if (handlersFinished_.wait_until(lock, drainDeadline_, handlersFinished))
+        return;
+
+    std::cerr << "WARNING: " << connectionSockets_.size() << " TCP connections were still open after "
+              << options_.drainTimeoutMs << " ms of draining, they are closed and their remaining messages are dropped.\n";
+
+    // shutdown wakes up handlers blocked in poll(), recv() or send(); handlers use the listener's state,
+    // so they are waited for without a deadline instead of being left running after run() returns
+    for (const auto connectionSocket : connectionSockets_)
+        shutdown(connectionSocket, SHUT_RDWR);
+    handlersFinished_.wait(lock, handlersFinished);
+}
+
+void TcpListener::connectionOpened(int connectionSocket)
+{
+    std::lock_guard<std::mutex> lock(handlersMutex_);
+    connectionSockets_.insert(connectionSocket);
+}
+
+void TcpListener::closeConnection(int connectionSocket)
+{
+    // closed under the lock, so waitForHandlers() never shuts down a descriptor number that was reused
+    std::lock_guard<std::mutex> lock(handlersMutex_);
+    connectionSockets_.erase(connectionSocket);
+    close(connectionSocket);
+}
+
+bool TcpListener::hasConnections()
+{
+    std::lock_guard<std::mutex> lock(handlersMutex_);
+    return !connectionSockets_.empty();
+}
+
+//---------------------------------------------------------
+
+void TcpListener::handleConnection(int connectionSocket, sockaddr_in clientAddress, int cpu)
+{
+    // pinning before allocation, so the read buffer lands on the worker core's NUMA node
+    pinCurrentThread(cpu);
+    char *readBuffer = allocateLocalBuffer(bufferSize_);
+
+    Connection connection;
+    connection.socket = connectionSocket;
+    connection.clientAddress = clientAddress;
+
+    while (readBuffer != nullptr && !drainTimedOut())
     {
-        const auto rSize = recv(connectionSocket, readBuffer, bufferSize_, 0);
-        if (rSize < 0)
-        {
-            std::cerr << "ERROR while receiving message from " << inet_ntoa(clientAddress.sin_addr)
-                    << ":" << ntohs(clientAddress.sin_port) << "...\n";
-            close(connectionSocket);
+        const auto result = readConnection(connection, readBuffer);
+        if (result == ReadResult::Closed)
             break;
+
+        // nothing queued - sleeping until client sends more or disconnects, even while the server is stopping
+        if (result == ReadResult::NothingQueued && !waitForClient(connectionSocket))
+            break;
+    }
+    closeConnection(connectionSocket);
+    releaseLocalBuffer(readBuffer, bufferSize_);
+    handlerFinished();
+}
+
+//---------------------------------------------------------
+
+bool TcpListener::startEventWorkers()
+{
+    for (auto i = 0; i < options_.tcpEventWorkers; ++i)
+    {
+        const auto epollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+        if (epollDescriptor < 0)
+        {
+            std::cerr << "ERROR: failed to create epoll instance for TCP event worker (" << std::strerror(errno) << ")!\n";
+            return false;
         }
-        else if (rSize == globals::disconnectionMsgLength)
+        eventWorkerDescriptors_.push_back(epollDescriptor);
+
+        // stop event is the only registration without connection state, a worker without it couldn't be stopped
+        epoll_event stopEvent;
+        std::memset(&stopEvent, 0x00, sizeof stopEvent);
+        stopEvent.events = EPOLLIN;
+        stopEvent.data.ptr = nullptr;
+        if (epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, stopDescriptor_, &stopEvent) != 0)
         {
-            // TCP connection was closed
-            close(connectionSocket);
-            break;
+            std::cerr << "ERROR: failed to register stop event in TCP event worker (" << std::strerror(errno) << ")!\n";
+            return false;
         }
 
-        std::string messageString;
-        messageString.append(readBuffer, readBuffer + rSize);
-        std::memset(readBuffer, 0x00, bufferSize_);
+        auto workerCpu = anyCpu;
+        if (!options_.workerCpus.empty())
+            workerCpu = options_.workerCpus[i % options_.workerCpus.size()];
 
-        // printing message
-        std::cout << "Message from " << inet_ntoa(clientAddress.sin_addr) << ":"
-                  << ntohs(clientAddress.sin_port) << ": " << messageString << "\n";
+        {
+            std::lock_guard<std::mutex> lock(handlersMutex_);
+            ++activeHandlers_;
+        }
+        std::thread(&TcpListener::runEventWorker, this, epollDescriptor, workerCpu).detach();
+    }
 
-        // sending echo
-        send(connectionSocket, messageString.c_str(), rSize, 0);
+    return true;
+}
 
-        processMessage(messageString);
+void TcpListener::closeEventWorkers()
+{
+    for (const auto epollDescriptor : eventWorkerDescriptors_)
+        close(epollDescriptor);
+    eventWorkerDescriptors_.clear();
+}
+
+void TcpListener::addToEventWorker(int connectionSocket, const sockaddr_in &clientAddress)
+{
+    const auto flags = fcntl(connectionSocket, F_GETFL, 0);
+    fcntl(connectionSocket, F_SETFL, flags | O_NONBLOCK);
+
+    auto connection = new Connection;
+    connection->socket = connectionSocket;
+    connection->clientAddress = clientAddress;
+
+    epoll_event event;
+    std::memset(&event, 0x00, sizeof event);
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = connection;
+
+    // from here on the connection is owned by the worker thread
+    connectionOpened(connectionSocket);
+    const auto epollDescriptor = eventWorkerDescriptors_[nextEventWorker_++ % eventWorkerDescriptors_.size()];
+    if (epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, connectionSocket, &event) != 0)
+    {
+        std::cerr << "ERROR: failed to register connection from " << inet_ntoa(clientAddress.sin_addr)
+                  << ":" << ntohs(clientAddress.sin_port) << " in event worker...\n";
+        closeConnection(connectionSocket);
+        delete connection;
+    }
+}
+
+bool TcpListener::flushPendingEcho(Connection &connection)
+{
+    ECHO_TRACE_SCOPE("tcp.send");
+    while (!connection.pendingEcho.empty())
+    {
+        const auto sSize = send(connection.socket, connection.pendingEcho.data(), connection.pendingEcho.size(), MSG_NOSIGNAL);
+        if (sSize < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+
+        connection.pendingEcho.erase(0, sSize);
+    }
+    return true;
+}
+
+bool TcpListener::serveMessage(Connection &connection, const std::string &message)
+{
+    // printing message
+    printMessage(message, connection.clientAddress);
+    captureMessage(capture::Protocol::TCP, message, connection.clientAddress);
+
+    // sending echo; whatever a non-blocking socket doesn't accept now is sent once it becomes writable
+    connection.pendingEcho.append(message);
+    const auto connectionIsAlive = flushPendingEcho(connection);
+
+    processMessage(message);
+    return connectionIsAlive;
+}
+
+TcpListener::ReadResult TcpListener::readConnection(Connection &connection, char *readBuffer)
+{
+    ECHO_TRACE_BEGIN(recvTrace);
+    const auto rSize = recv(connection.socket, readBuffer, bufferSize_, MSG_DONTWAIT);
+    ECHO_TRACE_END(recvTrace, "tcp.recv");
+    if (rSize < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return ReadResult::NothingQueued;
+
+        std::cerr << "ERROR while receiving message from " << inet_ntoa(connection.clientAddress.sin_addr)
+                  << ":" << ntohs(connection.clientAddress.sin_port) << "...\n";
+        return ReadResult::Closed;
+    }
+    else if (rSize == globals::disconnectionMsgLength)
+    {
+        // TCP connection was closed
+        return ReadResult::Closed;
+    }
+
+    return serveMessage(connection, std::string(readBuffer, rSize)) ? ReadResult::Served : ReadResult::Closed;
+}
+
+void TcpListener::runEventWorker(int epollDescriptor, int cpu)
+{
+    // pinning before allocation, so the read buffer lands on the worker core's NUMA node
+    pinCurrentThread(cpu);
+    char *readBuffer = allocateLocalBuffer(bufferSize_);
+
+    constexpr auto maxEvents = 64;
+    constexpr auto drainPollIntervalMs = 10;
+    epoll_event events[maxEvents];
+    auto stopping = false;
+
+    while (readBuffer != nullptr && !drainTimedOut())
+    {
+        // while stopping clients are served until all of them disconnect, waking up regularly to check for that
+        const auto timeout = stopping ? drainPollIntervalMs : -1;
+        const auto ready = epoll_wait(epollDescriptor, events, maxEvents, timeout);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            std::cerr << "ERROR: TCP event worker failed to wait for events (" << std::strerror(errno) << ")!\n";
+            break;
+        }
+
+        for (auto i = 0; i < ready; ++i)
+        {
+            if (events[i].data.ptr == nullptr)
+            {
+                // stop event stays readable, so it is unregistered to let the drain loop wait for clients
+                stopping = true;
+                epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, stopDescriptor_, nullptr);
+                continue;
+            }
+
+            auto connection = static_cast<Connection*>(events[i].data.ptr);
+            auto keepOpen = (events[i].events & EPOLLERR) == 0;
+
+            if (keepOpen && (events[i].events & EPOLLOUT))
+                keepOpen = flushPendingEcho(*connection);
+            if (keepOpen && !connection->waitingForWrite && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+                keepOpen = readConnection(*connection, readBuffer) != ReadResult::Closed;
+
+            if (!keepOpen)
+            {
+                // closing the socket also removes it from the epoll instance
+                closeConnection(connection->socket);
+                delete connection;
+                continue;
+            }
+
+            // reading is paused while echo is pending, so a slow reader can't make the server buffer without bound
+            const auto waitForWrite = !connection->pendingEcho.empty();
+            if (waitForWrite != connection->waitingForWrite)
+            {
+                epoll_event event;
+                std::memset(&event, 0x00, sizeof event);
+                event.events = waitForWrite ? EPOLLOUT : (EPOLLIN | EPOLLRDHUP);
+                event.data.ptr = connection;
+                epoll_ctl(epollDescriptor, EPOLL_CTL_MOD, connection->socket, &event);
+                connection->waitingForWrite = waitForWrite;
+            }
+        }
+
+        if (stopping && !hasConnections())
+            break;
     }
-    delete readBuffer;
+
+    // connections still registered once drain timeout runs out are shut down by waitForHandlers()
+    // and closed when the process exits
+    releaseLocalBuffer(readBuffer, bufferSize_);
+    handlerFinished();
 }
 
+//---------------------------------------------------------
 
 void TcpListener::run()
 {
     if (!isInitialized_)
     {
         std::cerr << globals::listenerUninitSocketError;
+        reportStarted(false);
         return;
     }
 
+    pinCurrentThread(options_.tcpListenerCpu);
+
     int connection;
     sockaddr_in clientAddress;
     socklen_t clientAddressLength = sizeof clientAddress;
+    std::size_t nextWorkerCpu = 0;
 
     if (listen(socketDescriptor_, 10) == globals::failureToListenCode)
     {
         std::cerr << "ERROR: failed to listen to socket...\n";
+        reportStarted(false);
         return;
     }
 
-    while (true)
+    if (options_.tcpEventWorkers > 0 && !startEventWorkers())
     {
-        connection = accept(socketDescriptor_, reinterpret_cast<sockaddr*>(&clientAddress), &clientAddressLength);
+        // workers that did start have no clients yet, they quit as soon as they see the stop event
+        std::cerr << "ERROR: TCP event workers couldn't be started, TCP listener is stopped.\n";
+        stop();
+        waitForHandlers();
+        closeEventWorkers();
+        reportStarted(false);
+        return;
+    }
+
+    // non-blocking, so a connection taken by the other process during hand-over doesn't block accept()
+    fcntl(socketDescriptor_, F_SETFL, fcntl(socketDescriptor_, F_GETFL, 0) | O_NONBLOCK);
+    reportStarted(true);
+
+    while (waitForData(socketDescriptor_) && !stopping_)
+    {
+        clientAddressLength = sizeof clientAddress;
+        connection = accept4(socketDescriptor_, reinterpret_cast<sockaddr*>(&clientAddress), &clientAddressLength, SOCK_CLOEXEC);
         if (connection < 0)
         {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                continue;
+
             std::cerr << "ERROR: failed to accept connection from " << inet_ntoa(clientAddress.sin_addr)
                       << ":" << ntohs(clientAddress.sin_port) << "...\n";
             continue;
         }
 
-        std::thread(&TcpListener::handleConnection, this, connection, clientAddress).detach();
+        if (!eventWorkerDescriptors_.empty())
+        {
+            addToEventWorker(connection, clientAddress);
+            continue;
+        }
+
+        auto workerCpu = anyCpu;
+        if (!options_.workerCpus.empty())
+            workerCpu = options_.workerCpus[nextWorkerCpu++ % options_.workerCpus.size()];
+
+        {
+            std::lock_guard<std::mutex> lock(handlersMutex_);
+            ++activeHandlers_;
+            connectionSockets_.insert(connection);
+        }
+        std::thread(&TcpListener::handleConnection, this, connection, clientAddress, workerCpu).detach();
     }
+
+    // no new clients from here on, waiting for the ones already connected to disconnect
+    waitForHandlers();
+    closeEventWorkers();
 }
 
 //=========================================================
 
-UdpListener::UdpListener(uint16_t port, uint32_t bufferSize)
-    : BaseListener(port, bufferSize)
+UdpListener::UdpListener(const ServerOptions &options, CaptureWriter *capture, WorkerPool *numbersPool)
+    : BaseListener(options, capture, numbersPool)
 {
-    isInitialized_ = prepareSocket(SOCK_DGRAM, IPPROTO_UDP, "UDP");
+    if (options_.inheritedUdpDescriptor >= 0)
+        isInitialized_ = adoptSocket(options_.inheritedUdpDescriptor, SOCK_DGRAM, "UDP");
+    else
+        isInitialized_ = prepareSocket(SOCK_DGRAM, IPPROTO_UDP, "UDP");
+    if (isInitialized_ && options_.udpGro)
+        useGro_ = useGso_ = enableGro();
+
+    if (isInitialized_ && options_.busyPollMicroseconds > 0)
+    {
+        const int busyPoll = options_.busyPollMicroseconds;
+        if (setsockopt(socketDescriptor_, SOL_SOCKET, SO_BUSY_POLL, &busyPoll, sizeof busyPoll) != 0)
+        {
+            std::cerr << "WARNING: failed to set SO_BUSY_POLL on the UDP socket (" << std::strerror(errno)
+                      << "), raising it above net.core.busy_read requires CAP_NET_ADMIN.\n";
+        }
+    }
 }
 
 //---------------------------------------------------------
 
+bool UdpListener::receiveDatagram(msghdr &message, ssize_t &rSize)
+{
+    // queued datagrams are taken without blocking, the listener only sleeps in poll() where stop() can wake it up
+    const auto spin = options_.spinMicroseconds > 0;
+    const auto spinDeadline = spin ? std::chrono::steady_clock::now() + std::chrono::microseconds(options_.spinMicroseconds)
+                                   : std::chrono::steady_clock::time_point();
+    while (!drainTimedOut())
+    {
+        // only the call that returns a datagram is traced, empty spinning reads would flood the trace
+        ECHO_TRACE_BEGIN(recvTrace);
+        rSize = recvmsg(socketDescriptor_, &message, MSG_DONTWAIT);
+        if (rSize >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            ECHO_TRACE_END(recvTrace, "udp.recv");
+            return true;
+        }
+
+        if (spin && std::chrono::steady_clock::now() < spinDeadline)
+            continue;
+
+        // idle time is a stage of its own, so it doesn't hide in the receive time
+        ECHO_TRACE_BEGIN(waitTrace);
+        const auto hasData = waitForData(socketDescriptor_);
+        ECHO_TRACE_END(waitTrace, "udp.wait");
+        if (!hasData)
+            return false;
+    }
+
+    return false;
+}
+
+//---------------------------------------------------------
+
+bool UdpListener::enableGro()
+{
+    if (bufferSize_ < globals::maxUdpPayloadSize)
+    {
+        std::cerr << "WARNING: UDP_GRO requires read buffer of at least " << globals::maxUdpPayloadSize
+                  << " bytes, UDP GRO / GSO stays disabled.\n";
+        return false;
+    }
+
+    const int enable = 1;
+    if (setsockopt(socketDescriptor_, IPPROTO_UDP, globals::udpGroOption, &enable, sizeof enable) != 0)
+    {
+        std::cerr << "WARNING: kernel does not support UDP_GRO (" << std::strerror(errno)
+                  << "), UDP GRO / GSO stays disabled.\n";
+        return false;
+    }
+
+    return true;
+}
+
+void UdpListener::sendDatagrams(const char *data, std::size_t size, std::size_t segmentSize, const sockaddr_in &clientAddress)
+{
+    const socklen_t clientAddressLength = sizeof clientAddress;
+    // at least one datagram is sent, so an empty datagram gets its empty echo
+    std::size_t offset = 0;
+    do
+    {
+        while (sendto(socketDescriptor_, data + offset, std::min(segmentSize, size - offset), MSG_CONFIRM,
+                      reinterpret_cast<const sockaddr*>(&clientAddress), clientAddressLength) < 0 && errno == EINTR) {}
+        offset += segmentSize;
+    } while (offset < size);
+}
+
+bool UdpListener::sendGsoBatch(const char *data, std::size_t size, std::size_t segmentSize, const sockaddr_in &clientAddress)
+{
+    iovec iov;
+    iov.iov_base = const_cast<char*>(data);
+    iov.iov_len = size;
+
+    // union aligns the buffer for cmsghdr, a plain char array may be misaligned
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(uint16_t))];
+        cmsghdr align;
+    } control;
+    std::memset(&control, 0x00, sizeof control);
+
+    msghdr message;
+    std::memset(&message, 0x00, sizeof message);
+    message.msg_name = const_cast<sockaddr_in*>(&clientAddress);
+    message.msg_namelen = sizeof clientAddress;
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof control.buffer;
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = globals::udpSegmentOption;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    const uint16_t gsoSize = segmentSize;
+    std::memcpy(CMSG_DATA(cmsg), &gsoSize, sizeof gsoSize);
+
+    ssize_t sSize = 0;
+    while ((sSize = sendmsg(socketDescriptor_, &message, MSG_CONFIRM)) < 0 && errno == EINTR) {}
+    return sSize >= 0;
+}
+
+void UdpListener::sendEcho(const char *data, std::size_t size, std::size_t segmentSize, const sockaddr_in &clientAddress)
+{
+    ECHO_TRACE_SCOPE("udp.send");
+    if (size <= segmentSize || !useGso_)
+    {
+        sendDatagrams(data, size, segmentSize, clientAddress);
+        return;
+    }
+
+    // coalesced buffer goes back in as few calls as possible; kernel cuts every call into segmentSize-sized
+    // datagrams, but accepts at most maxGsoSegments of them at once
+    const auto batchSize = segmentSize * globals::maxGsoSegments;
+    for (std::size_t offset = 0; offset < size; offset += batchSize)
+    {
+        const auto length = std::min(batchSize, size - offset);
+        if (!useGso_ || length <= segmentSize)
+        {
+            sendDatagrams(data + offset, length, segmentSize, clientAddress);
+            continue;
+        }
+
+        if (sendGsoBatch(data + offset, length, segmentSize, clientAddress))
+            continue;
+
+        // device without checksum offload or kernel without UDP_SEGMENT won't accept later batches either
+        if (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP)
+        {
+            std::cerr << "WARNING: UDP_SEGMENT send failed (" << std::strerror(errno)
+                      << "), UDP echoes are sent one datagram per call from now on.\n";
+            useGso_ = false;
+        }
+
+        // the failed batch is not lost - its datagrams are sent one by one
+        sendDatagrams(data + offset, length, segmentSize, clientAddress);
+    }
+}
+
+void UdpListener::runGro()
+{
+    char *readBuffer = allocateLocalBuffer(bufferSize_);
+    reportStarted(readBuffer != nullptr);
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        cmsghdr align;
+    } control;
+    sockaddr_in clientAddress;
+
+    while (readBuffer != nullptr)
+    {
+        iovec iov;
+        iov.iov_base = readBuffer;
+        iov.iov_len = bufferSize_;
+
+        msghdr message;
+        std::memset(&message, 0x00, sizeof message);
+        message.msg_name = &clientAddress;
+        message.msg_namelen = sizeof clientAddress;
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof control.buffer;
+
+        ssize_t rSize = 0;
+        if (!receiveDatagram(message, rSize))
+            break;
+
+        if (rSize < 0)
+        {
+            std::cerr << "ERROR while receiving message from " << inet_ntoa(clientAddress.sin_addr)
+                      << ":" << ntohs(clientAddress.sin_port) << "...\n";
+            continue;
+        }
+
+        if (message.msg_flags & MSG_TRUNC)
+        {
+            std::cerr << "WARNING: datagrams from " << inet_ntoa(clientAddress.sin_addr) << ":" << ntohs(clientAddress.sin_port)
+                      << " didn't fit into the read buffer, only the first " << rSize << " bytes are handled.\n";
+        }
+
+        // without UDP_GRO control message the buffer holds a single datagram
+        std::size_t segmentSize = rSize;
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg))
+        {
+            if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == globals::udpGroOption)
+            {
+                int groSize = 0;
+                std::memcpy(&groSize, CMSG_DATA(cmsg), sizeof groSize);
+                if (groSize > 0)
+                    segmentSize = groSize;
+            }
+        }
+
+        // splitting coalesced buffer back into individual messages
+        ECHO_TRACE_BEGIN(splitTrace);
+        std::vector<std::string> messages;
+        if (rSize > 0)
+        {
+            messages.reserve((rSize + segmentSize - 1) / segmentSize);
+            for (std::size_t offset = 0; offset < static_cast<std::size_t>(rSize); offset += segmentSize)
+                messages.emplace_back(readBuffer + offset, std::min<std::size_t>(segmentSize, rSize - offset));
+        }
+        else
+        {
+            // empty datagram is never coalesced, it is a message of its own like in run()
+            messages.emplace_back();
+        }
+        ECHO_TRACE_END(splitTrace, "udp.split");
+
+        // printing messages
+        for (const auto &messageString : messages)
+        {
+            printMessage(messageString, clientAddress);
+            captureMessage(capture::Protocol::UDP, messageString, clientAddress);
+        }
+
+        // sending echo
+        sendEcho(readBuffer, rSize, segmentSize, clientAddress);
+
+        for (const auto &messageString : messages)
+            processMessage(messageString);
+    }
+
+    releaseLocalBuffer(readBuffer, bufferSize_);
+}
+
 void UdpListener::run()
 {
     if (!isInitialized_)
     {
         std::cerr << globals::listenerUninitSocketError;
+        reportStarted(false);
+        return;
+    }
+
+    // pinning before allocation, so the read buffer lands on the listener core's NUMA node
+    pinCurrentThread(options_.udpListenerCpu);
+
+    if (useGro_)
+    {
+        runGro();
         return;
     }
 
-    char *readBuffer = new char [bufferSize_];
+    char *readBuffer = allocateLocalBuffer(bufferSize_);
+    reportStarted(readBuffer != nullptr);
     sockaddr_in clientAddress;
     socklen_t clientAddressLength = sizeof clientAddress;
 
-    while (true)
+    while (readBuffer != nullptr)
     {
-        const auto rSize = recvfrom(socketDescriptor_, readBuffer, bufferSize_,
-                                    MSG_WAITALL, reinterpret_cast<sockaddr*>(&clientAddress), &clientAddressLength);
+        iovec iov;
+        iov.iov_base = readBuffer;
+        iov.iov_len = bufferSize_;
+
+        msghdr message;
+        std::memset(&message, 0x00, sizeof message);
+        message.msg_name = &clientAddress;
+        message.msg_namelen = clientAddressLength;
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+
+        ssize_t rSize = 0;
+        if (!receiveDatagram(message, rSize))
+            break;
 
         if (rSize < 0)
         {
@@ -208,20 +924,22 @@ void UdpListener::run()
 
         std::string messageString;
         messageString.append(readBuffer, readBuffer + rSize);
-        std::memset(readBuffer, 0x00, bufferSize_);
+        std::memset(readBuffer, 0x00, rSize);
 
         // printing message
-        std::cout << "Message from " << inet_ntoa(clientAddress.sin_addr) << ":"
-                  << ntohs(clientAddress.sin_port) << ": " << messageString << "\n";
+        printMessage(messageString, clientAddress);
+        captureMessage(capture::Protocol::UDP, messageString, clientAddress);
 
         // sending echo
+        ECHO_TRACE_BEGIN(sendTrace);
         sendto(socketDescriptor_, messageString.c_str(), rSize,
                MSG_CONFIRM, reinterpret_cast<sockaddr*>(&clientAddress), clientAddressLength);
+        ECHO_TRACE_END(sendTrace, "udp.send");
 
         processMessage(messageString);
     }
 
-    delete readBuffer;
+    releaseLocalBuffer(readBuffer, bufferSize_);
 }
 
 }
@@ -1,7 +1,18 @@
 #ifndef INCLUDE_ONCE_49892D43_0CB3_4988_B2DC_861E13762096
 #define INCLUDE_ONCE_49892D43_0CB3_4988_B2DC_861E13762096
 
+#include "serveroptions.h"
+#include "capturewriter.h"
+#include "workerpool.h"
+
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <vector>
+#include <condition_variable>
+#include <sys/socket.h>
 #include <netinet/in.h>
 
 namespace echoserver
@@ -12,9 +23,11 @@ class BaseListener
 {
 public:
     /// @brief BaseListener class constructor
-    /// @param port port the listener will be listening to if its socket is created and bound successfully
-    /// @param bufferSize size of the read buffer
-    BaseListener(uint16_t port, uint32_t bufferSize);
+    /// @param options server settings; port the listener will be listening to if its socket is created and bound
+    ///        successfully, size of the read buffer and protocol-specific options
+    /// @param capture writer received messages are captured to, nullptr - capture disabled
+    /// @param numbersPool pool shared by all listeners for processing large messages, nullptr - no parallel processing
+    BaseListener(const ServerOptions &options, CaptureWriter *capture, WorkerPool *numbersPool);
     /// @brief BaseListener class destructor
     ~BaseListener();
 
@@ -26,23 +39,76 @@ public:
     /// @brief tells, which port is bound to the listener's socket
     /// @return port number
     int getPort() const { return ntohs(socketAddress_.sin_port); }
+    /// @brief tells descriptor of the listener's socket, needed to hand the socket over to a new process
+    /// @returns socket descriptor
+    int getSocketDescriptor() const { return socketDescriptor_; }
+    /// @brief makes the listener stop receiving new clients, finish messages that were already received and keep
+    ///        serving connected clients until they disconnect; run() returns once that is done or options.drainTimeoutMs
+    ///        runs out, remaining connections are shut down then; safe to call from any thread
+    void stop();
+    /// @brief waits until run() starts serving clients or fails to; safe to call from any thread
+    /// @returns true if the listener is serving clients, false - if it failed to start
+    bool waitUntilStarted();
 
 protected:
+    /// @brief tells threads waiting in waitUntilStarted() whether run() started serving clients
+    /// @param started true if run() serves clients, false - if it failed to start
+    void reportStarted(bool started);
     /// @brief creates and binds a socket
     /// @param type specifies type of the socket to be created
     /// @param protocol specifies protocol that will be used the socket
     /// @param typeString socket's type string, needed for error messages
     /// @returns true if socket was created and binded successfully, false - otherwise
     bool prepareSocket(int type, int protocol, const std::string &typeString);
+    /// @brief takes over a bound socket inherited from the previous server process
+    /// @param descriptor inherited socket descriptor
+    /// @param type expected type of the socket
+    /// @param typeString socket's type string, needed for error messages
+    /// @returns true if descriptor is a bound socket of the expected type, false - otherwise
+    bool adoptSocket(int descriptor, int type, const std::string &typeString);
+    /// @brief waits until descriptor has data to read or the listener is stopped
+    /// @param descriptor descriptor to wait for
+    /// @returns true if descriptor is readable, false - if listener is stopping and descriptor has nothing left to read
+    bool waitForData(int descriptor) const;
+    /// @brief waits until connected client sends data or closes connection; a stopping listener
+    ///        keeps waiting until its drain timeout runs out
+    /// @param descriptor descriptor of client's socket
+    /// @returns true if descriptor is readable, false - if drain timeout ran out
+    bool waitForClient(int descriptor) const;
+    /// @brief tells, whether the listener is stopping and its drain timeout ran out
+    /// @returns true if remaining messages must be dropped, false - otherwise
+    bool drainTimedOut() const;
     /// @brief processes message received by the listener's socket
     /// @param message text of the message
     void processMessage(const std::string &message);
+    /// @brief prints message received by the listener's socket
+    /// @param message text of the message
+    /// @param clientAddress client's address data
+    void printMessage(const std::string &message, const sockaddr_in &clientAddress);
+    /// @brief queues received message for the capture file, if capture is enabled
+    /// @param protocol protocol the message was received by
+    /// @param message text of the message
+    /// @param clientAddress client's address data
+    void captureMessage(capture::Protocol protocol, const std::string &message, const sockaddr_in &clientAddress);
 
-    int socketDescriptor_;          /// < descriptor of the listener's socket
+    int socketDescriptor_ = -1;     /// < descriptor of the listener's socket
     sockaddr_in socketAddress_;     /// < address bound to the listener's socket
     uint32_t bufferSize_;           /// < size of the listener's read buffer
+    ServerOptions options_;         /// < server settings the listener was created with
+    CaptureWriter *capture_;        /// < writer received messages are captured to, nullptr - capture disabled
+    WorkerPool *numbersPool_;       /// < pool large messages are processed by, nullptr - no parallel processing
 
     bool isInitialized_ = false;    /// < true if the listener's was socket created and bound successfully
+
+    int stopDescriptor_ = -1;                                   /// < eventfd that becomes readable once stop() is called
+    std::mutex stopMutex_;                                      /// < serializes stop() calls
+    std::atomic<bool> stopping_;                                /// < true once stop() is called
+    std::chrono::steady_clock::time_point drainDeadline_;      /// < when listener gives up on remaining messages, set before stopping_
+
+    std::mutex startMutex_;                                     /// < guards startReported_ and started_
+    std::condition_variable startChanged_;                      /// < notified once run() reports whether it started
+    bool startReported_ = false;                                /// < true once run() reported whether it started
+    bool started_ = false;                                      /// < true if run() serves clients
 };
 
 /// @brief class for echoServer listener that uses TCP protocol
@@ -50,16 +116,87 @@ class TcpListener : public BaseListener
 {
 public:
     /// @brief TcpListener class constructor
-    /// @param port port the listener will be listening to if its socket is created and bound successfully
-    /// @param bufferSize size of the read buffer
-    TcpListener(uint16_t port, uint32_t bufferSize);
+    /// @param options server settings, see BaseListener
+    /// @param capture writer received messages are captured to, nullptr - capture disabled
+    /// @param numbersPool pool large messages are processed by, nullptr - no parallel processing
+    TcpListener(const ServerOptions &options, CaptureWriter *capture, WorkerPool *numbersPool);
     /// @brief runs the TCP listener
     void run() override;
 private:
     /// @brief handles connection with a TCP client
     /// @param connectionSocket descriptor of client's socket
     /// @param clientAddress client's address data
-    void handleConnection(int connectionSocket, sockaddr_in clientAddress);
+    /// @param cpu core the connection thread is pinned to, or anyCpu
+    void handleConnection(int connectionSocket, sockaddr_in clientAddress, int cpu);
+    /// @brief marks one connection thread or event loop worker as finished
+    void handlerFinished();
+    /// @brief waits until all connection threads and event loop workers finish; once drain timeout runs out
+    ///        remaining connections are shut down and handlers are waited for without a deadline,
+    ///        so none of them outlives the listener
+    void waitForHandlers();
+    /// @brief remembers socket of an accepted client, so it can be shut down when drain timeout runs out
+    /// @param connectionSocket descriptor of client's socket
+    void connectionOpened(int connectionSocket);
+    /// @brief forgets and closes socket of a client
+    /// @param connectionSocket descriptor of client's socket
+    void closeConnection(int connectionSocket);
+    /// @brief tells, whether any client is still connected
+    /// @returns true if at least one connection is open, false - otherwise
+    bool hasConnections();
+
+    /// @brief state of a TCP client, used by both connection threads and event loop workers
+    struct Connection
+    {
+        int socket;                     /// < descriptor of client's socket (non-blocking for event loop workers)
+        sockaddr_in clientAddress;      /// < client's address data
+        std::string pendingEcho;        /// < part of the echo the socket hasn't accepted yet
+        bool waitingForWrite = false;   /// < true while reading is paused until pendingEcho is sent
+    };
+
+    /// @brief outcome of reading from a connection
+    enum class ReadResult
+    {
+        Served,         /// < a message was received and served
+        NothingQueued,  /// < socket had no data
+        Closed,         /// < client closed connection or connection failed
+    };
+
+    /// @brief creates epoll instances and threads of event loop workers
+    /// @returns true if all workers were started, false - otherwise
+    bool startEventWorkers();
+    /// @brief closes epoll instances of event loop workers, which must have finished already
+    void closeEventWorkers();
+    /// @brief hands accepted connection over to one of event loop workers in round-robin order
+    /// @param connectionSocket descriptor of client's socket
+    /// @param clientAddress client's address data
+    void addToEventWorker(int connectionSocket, const sockaddr_in &clientAddress);
+    /// @brief serves connections registered in an epoll instance until the process exits
+    /// @param epollDescriptor worker's epoll instance
+    /// @param cpu core the worker thread is pinned to, or anyCpu
+    void runEventWorker(int epollDescriptor, int cpu);
+    /// @brief reads one message from a connection without blocking and serves it
+    /// @param connection client's state
+    /// @param readBuffer thread's read buffer
+    /// @returns what happened
+    ReadResult readConnection(Connection &connection, char *readBuffer);
+    /// @brief prints, captures, echoes and processes a message received from a TCP client;
+    ///        the only place both connection models handle messages, so they can't drift apart
+    /// @param connection client's state
+    /// @param message text of the message
+    /// @returns false if connection failed, true - otherwise
+    bool serveMessage(Connection &connection, const std::string &message);
+    /// @brief sends as much of the pending echo as the socket accepts; a blocking socket accepts all of it
+    /// @param connection client's state
+    /// @returns false if connection failed, true - otherwise
+    bool flushPendingEcho(Connection &connection);
+
+    std::vector<int> eventWorkerDescriptors_;   /// < epoll instances of event loop workers, empty in thread-per-connection mode
+    std::size_t nextEventWorker_ = 0;           /// < worker the next accepted connection goes to
+
+    std::mutex handlersMutex_;                  /// < guards activeHandlers_ and connectionSockets_
+    std::condition_variable handlersFinished_;  /// < notified every time a handler finishes
+    int activeHandlers_ = 0;                    /// < number of running connection threads and event loop workers
+    std::set<int> connectionSockets_;           /// < sockets of connected clients in both connection models
 };
 
 /// @brief class for echoServer listener that uses UDP protocol
@@ -67,11 +204,46 @@ class UdpListener : public BaseListener
 {
 public:
     /// @brief UdpListener class constructor
-    /// @param port port the listener will be listening to if its socket is created and bound successfully
-    /// @param bufferSize size of the read buffer
-    UdpListener(uint16_t port, uint32_t bufferSize);
+    /// @param options server settings, see BaseListener
+    /// @param capture writer received messages are captured to, nullptr - capture disabled
+    /// @param numbersPool pool large messages are processed by, nullptr - no parallel processing
+    UdpListener(const ServerOptions &options, CaptureWriter *capture, WorkerPool *numbersPool);
     /// @brief runs the UDP listener
     void run() override;
+private:
+    /// @brief enables UDP_GRO on the listener's socket
+    /// @returns true if kernel accepted the option, false - otherwise
+    bool enableGro();
+    /// @brief receives a datagram, spinning on non-blocking reads for the configured time before blocking
+    /// @param message message header describing buffers to read into
+    /// @param rSize variable to store size of the received data to, -1 on error
+    /// @returns false if the listener was stopped and all queued datagrams are processed, true - otherwise
+    bool receiveDatagram(msghdr &message, ssize_t &rSize);
+    /// @brief receives datagrams with UDP_GRO enabled, splits coalesced buffers back into individual
+    ///        messages and echoes every coalesced buffer with a single UDP_SEGMENT (GSO) send
+    void runGro();
+    /// @brief sends echo of (possibly coalesced) datagrams back to client
+    /// @param data buffer holding one or more datagrams
+    /// @param size total size of the data
+    /// @param segmentSize size of every datagram within data (the last one may be shorter)
+    /// @param clientAddress client's address data
+    void sendEcho(const char *data, std::size_t size, std::size_t segmentSize, const sockaddr_in &clientAddress);
+    /// @brief sends up to maxGsoSegments datagrams with a single UDP_SEGMENT (GSO) call
+    /// @param data buffer holding datagrams back to back
+    /// @param size total size of the data
+    /// @param segmentSize size of every datagram within data (the last one may be shorter)
+    /// @param clientAddress client's address data
+    /// @returns true if kernel accepted the batch, false - otherwise (errno tells why)
+    bool sendGsoBatch(const char *data, std::size_t size, std::size_t segmentSize, const sockaddr_in &clientAddress);
+    /// @brief sends datagrams one per call
+    /// @param data buffer holding datagrams back to back
+    /// @param size total size of the data
+    /// @param segmentSize size of every datagram within data (the last one may be shorter)
+    /// @param clientAddress client's address data
+    void sendDatagrams(const char *data, std::size_t size, std::size_t segmentSize, const sockaddr_in &clientAddress);
+
+    bool useGro_ = false;           /// < true if UDP_GRO is enabled for the listener's socket
+    bool useGso_ = false;           /// < true while UDP_SEGMENT sends are accepted by the kernel
 };
 
 }
@@ -2,20 +2,315 @@
 #include "utils.h"
 #include "globals.h"
 
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <climits>
 #include <cstring>
+#include <sstream>
 #include <iostream>
+#include <unistd.h>
 
 namespace
 {
 
-constexpr auto EXPECTED_ARGUMENTS_COUNT = 2;    /// < how many arguments this applications expects in argv[]
+constexpr auto MIN_ARGUMENTS_COUNT = 2;         /// < how many arguments this applications expects in argv[] at least
 constexpr auto PORT_ARG_INDEX = 1;              /// < index of argument, which contains port number
+constexpr auto FIRST_OPTION_ARG_INDEX = 2;      /// < index of the first optional argument
+
+const std::string bufferSizeOption = "--buffer-size";               /// < size of the read buffers
+const std::string udpGroOption = "--udp-gro";                       /// < enables UDP GRO / GSO
+const std::string tcpCpuOption = "--tcp-cpu";                       /// < core for the TCP listener thread
+const std::string udpCpuOption = "--udp-cpu";                       /// < core for the UDP listener thread
+const std::string workerCpusOption = "--worker-cpus";               /// < cores for the TCP connection threads
+const std::string tcpWorkersOption = "--tcp-workers";               /// < number of TCP event loop workers
+const std::string busyPollOption = "--busy-poll";                   /// < SO_BUSY_POLL for the UDP socket
+const std::string spinOption = "--spin";                            /// < spin-before-sleep time for the UDP listener
+const std::string traceFileOption = "--trace-file";                 /// < file to dump trace points to
+const std::string drainTimeoutOption = "--drain-timeout";           /// < how long stopping server finishes received messages
+const std::string captureOption = "--capture";                      /// < file to capture received messages to
+const std::string parallelThresholdOption = "--parallel-threshold"; /// < message size from which numbers are processed in parallel
+const std::string parallelThreadsOption = "--parallel-threads";     /// < number of threads processing a large message
+
+/// @brief print usage hint for application
+void printUsageHint()
+{
+    std::cout << "Usage: echoServer <port number> [options]\n"
+                 "Options:\n"
+                 "  " << bufferSizeOption << " BYTES    size of the read buffers, i.e. the largest message (default "
+              << globals::defaultBufferSize << ")\n"
+                 "  " << udpGroOption << "              coalesce UDP datagrams on receive (UDP_GRO) and echo them in batches (UDP_SEGMENT)\n"
+                 "  " << tcpCpuOption << " CPU          pin TCP listener thread to a core\n"
+                 "  " << udpCpuOption << " CPU          pin UDP listener thread to a core\n"
+                 "  " << workerCpusOption << " CPU,CPU  pin TCP connection threads to cores in round-robin order\n"
+                 "  " << tcpWorkersOption << " N        serve TCP clients with N epoll event loop threads\n"
+                 "                         instead of a thread per connection\n"
+                 "  " << busyPollOption << " USEC       enable SO_BUSY_POLL on the UDP socket\n"
+                 "  " << spinOption << " USEC            spin on non-blocking UDP reads before going to sleep\n"
+                 "  " << traceFileOption << " PATH      write Chrome trace / Perfetto JSON to PATH on SIGUSR1\n"
+                 "                         (requires build with -DECHOSERVER_TRACING=ON)\n"
+                 "  " << drainTimeoutOption << " MS     on SIGTERM / SIGINT / SIGHUP keep processing received messages and\n"
+                 "                         serving connected clients for up to MS milliseconds (default 5000)\n"
+                 "  " << captureOption << " PATH         append received messages with timestamps and client addresses\n"
+                 "                         to PATH, replay it with 'echoClient replay'\n"
+                 "  " << parallelThresholdOption << " BYTES\n"
+                 "                         scan, sort and sum numbers of messages of at least BYTES in several\n"
+                 "                         threads (default 0 - never)\n"
+                 "  " << parallelThreadsOption << " N   number of threads shared by all large messages (default - one per\n"
+                 "                         core of " << workerCpusOption << ", pinned to them in round-robin order,\n"
+                 "                         or one per core)\n"
+                 "Signals:\n"
+                 "  SIGTERM, SIGINT         stop accepting clients, finish received messages, serve connected\n"
+                 "                         clients until they disconnect or drain timeout runs out and exit;\n"
+                 "                         sent again while draining - exit at once\n"
+                 "  SIGHUP                  start a new server process that takes over the listening sockets,\n"
+                 "                         and once it serves clients drain and exit the same way; if it doesn't\n"
+                 "                         start serving, keep running\n"
+              << globals::acceptedPortsString;
+}
+
+/// @brief reads non-negative integer value of an option
+/// @param argc arguments count
+/// @param argv arguments
+/// @param index index of the option's name, advanced to the option's value
+/// @param value variable to store value to
+/// @returns true if value was read, false - otherwise
+bool readOptionValue(int argc, char* argv[], int &index, int &value)
+{
+    if (index + 1 >= argc)
+    {
+        std::cerr << "Option '" << argv[index] << "' requires a value.\n";
+        return false;
+    }
+
+    ++index;
+    try
+    {
+        value = std::stoi(argv[index]);
+    }
+    catch (const std::exception &)
+    {
+        value = -1;
+    }
+
+    if (value < 0)
+    {
+        std::cerr << "Option '" << argv[index - 1] << "' expects a non-negative number, got '" << argv[index] << "'.\n";
+        return false;
+    }
+
+    return true;
+}
+
+/// @brief checks whether core index exists on this machine
+/// @param cpu core index
+/// @returns true if core exists, false - otherwise
+bool isValidCpu(int cpu)
+{
+    if (cpu >= sysconf(_SC_NPROCESSORS_CONF))
+    {
+        std::cerr << "There is no cpu " << cpu << " on this machine.\n";
+        return false;
+    }
+
+    return true;
+}
+
+/// @brief reads comma-separated list of cores
+/// @param argc arguments count
+/// @param argv arguments
+/// @param index index of the option's name, advanced to the option's value
+/// @param cpus list to fill
+/// @returns true if all cores in the list are valid, false - otherwise
+bool readCpuList(int argc, char* argv[], int &index, std::vector<int> &cpus)
+{
+    if (index + 1 >= argc)
+    {
+        std::cerr << "Option '" << argv[index] << "' requires a value.\n";
+        return false;
+    }
+
+    ++index;
+    std::stringstream list(argv[index]);
+    std::string item;
+    while (std::getline(list, item, ','))
+    {
+        auto cpu = -1;
+        try
+        {
+            cpu = std::stoi(item);
+        }
+        catch (const std::exception &) {}
+
+        if (cpu < 0)
+        {
+            std::cerr << "Option '" << argv[index - 1] << "' expects comma-separated core numbers, got '" << argv[index] << "'.\n";
+            return false;
+        }
+        if (!isValidCpu(cpu))
+            return false;
+
+        cpus.push_back(cpu);
+    }
+
+    return !cpus.empty();
+}
+
+/// @brief reads a descriptor number handed over by the previous server process; whether it is a socket
+///        of the right kind is checked by the listener that adopts it
+/// @param text text to read the number from
+/// @param end variable to store position after the number to
+/// @param descriptor variable to store descriptor to, -1 - none
+/// @returns true if text starts with -1 or a valid descriptor number, false - otherwise
+bool readInheritedDescriptor(const char *text, char *&end, int &descriptor)
+{
+    errno = 0;
+    const auto value = std::strtol(text, &end, 10);
+    if (end == text || errno != 0 || value < -1 || value > INT_MAX)
+        return false;
+
+    descriptor = static_cast<int>(value);
+    return true;
+}
+
+/// @brief reads descriptors handed over by the previous server process
+/// @param text option's value, "<tcp descriptor>,<udp descriptor>,<readiness descriptor>"
+/// @param options settings to fill
+/// @returns true if all descriptor numbers were read, false - otherwise
+bool readInheritedSockets(const char *text, echoserver::ServerOptions &options)
+{
+    char *end = nullptr;
+    if (!readInheritedDescriptor(text, end, options.inheritedTcpDescriptor) || *end != ',')
+        return false;
+
+    const char *udpText = end + 1;
+    if (!readInheritedDescriptor(udpText, end, options.inheritedUdpDescriptor) || *end != ',')
+        return false;
+
+    const char *readyText = end + 1;
+    return readInheritedDescriptor(readyText, end, options.readyDescriptor) && *end == '\0';
+}
+
+/// @brief reads optional arguments into server settings
+/// @param argc arguments count
+/// @param argv arguments
+/// @param options settings to fill
+/// @returns true if all optional arguments were recognized, false - otherwise
+bool parseOptions(int argc, char* argv[], echoserver::ServerOptions &options)
+{
+    for (auto i = FIRST_OPTION_ARG_INDEX; i < argc; ++i)
+    {
+        if (bufferSizeOption == argv[i])
+        {
+            auto bufferSize = 0;
+            if (!readOptionValue(argc, argv, i, bufferSize))
+                return false;
+            if (bufferSize == 0)
+            {
+                std::cerr << "Option '" << bufferSizeOption << "' expects a positive number.\n";
+                return false;
+            }
+            options.bufferSize = bufferSize;
+        }
+        else if (udpGroOption == argv[i])
+        {
+            options.udpGro = true;
+        }
+        else if (tcpCpuOption == argv[i])
+        {
+            if (!readOptionValue(argc, argv, i, options.tcpListenerCpu) || !isValidCpu(options.tcpListenerCpu))
+                return false;
+        }
+        else if (udpCpuOption == argv[i])
+        {
+            if (!readOptionValue(argc, argv, i, options.udpListenerCpu) || !isValidCpu(options.udpListenerCpu))
+                return false;
+        }
+        else if (workerCpusOption == argv[i])
+        {
+            if (!readCpuList(argc, argv, i, options.workerCpus))
+                return false;
+        }
+        else if (tcpWorkersOption == argv[i])
+        {
+            if (!readOptionValue(argc, argv, i, options.tcpEventWorkers))
+                return false;
+        }
+        else if (busyPollOption == argv[i])
+        {
+            if (!readOptionValue(argc, argv, i, options.busyPollMicroseconds))
+                return false;
+        }
+        else if (spinOption == argv[i])
+        {
+            if (!readOptionValue(argc, argv, i, options.spinMicroseconds))
+                return false;
+        }
+        else if (traceFileOption == argv[i])
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Option '" << argv[i] << "' requires a value.\n";
+                return false;
+            }
+            options.traceFile = argv[++i];
+        }
+        else if (captureOption == argv[i])
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Option '" << argv[i] << "' requires a value.\n";
+                return false;
+            }
+            options.captureFile = argv[++i];
+        }
+        else if (parallelThresholdOption == argv[i])
+        {
+            auto threshold = 0;
+            if (!readOptionValue(argc, argv, i, threshold))
+                return false;
+            options.parallelThreshold = threshold;
+        }
+        else if (parallelThreadsOption == argv[i])
+        {
+            auto threads = 0;
+            if (!readOptionValue(argc, argv, i, threads))
+                return false;
+            options.parallelThreads = threads;
+        }
+        else if (drainTimeoutOption == argv[i])
+        {
+            if (!readOptionValue(argc, argv, i, options.drainTimeoutMs))
+                return false;
+        }
+        else if (echoserver::inheritSocketsOption == argv[i])
+        {
+            // set by the previous server process on reload, -1 - none
+            if (i + 1 >= argc || !readInheritedSockets(argv[i + 1], options))
+            {
+                std::cerr << "Option '" << argv[i] << "' expects '<tcp descriptor>,<udp descriptor>,<readiness descriptor>'.\n";
+                return false;
+            }
+            ++i;
+        }
+        else
+        {
+            std::cerr << "Unrecognized option '" << argv[i] << "'.\n";
+            return false;
+        }
+    }
+
+    return true;
+}
 
 }
 
 int main(int argc, char* argv[])
 {
-    if (argc == EXPECTED_ARGUMENTS_COUNT)
+    if (argc >= MIN_ARGUMENTS_COUNT)
     {
         const auto port = utils::getPortFromArgumetns(argv[PORT_ARG_INDEX]);
         if (!utils::isAllowedPortNumber(port))
@@ -25,12 +320,33 @@ int main(int argc, char* argv[])
             return globals::appExitCode;
         }
 
-        echoserver::EchoServer server(port, globals::defaultBufferSize);
+        echoserver::ServerOptions options;
+        options.port = port;
+        options.bufferSize = globals::defaultBufferSize;
+        options.commandLine.assign(argv, argv + argc);
+
+        // resolved now, so a reload after the binary was replaced on disk starts the new binary
+        char executablePath[PATH_MAX];
+        const auto pathLength = readlink("/proc/self/exe", executablePath, sizeof executablePath - 1);
+        if (pathLength > 0)
+            options.executablePath.assign(executablePath, pathLength);
+        if (!parseOptions(argc, argv, options))
+        {
+            printUsageHint();
+            return globals::appExitCode;
+        }
+        // by default large messages get the cores connection threads are placed on, or all of them
+        if (options.parallelThreads == 0 && !options.workerCpus.empty())
+            options.parallelThreads = options.workerCpus.size();
+        if (options.parallelThreads == 0)
+            options.parallelThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        echoserver::EchoServer server(options);
         server.run();
     }
     else
     {
-        std::cout << "Usage: echoServer <port number>\n" << globals::acceptedPortsString;
+        printUsageHint();
         return globals::appExitCode;
     }
 
@@ -0,0 +1,121 @@
+#include "messagenumbers.h"
+#include "tracing.h"
+
+#include <regex>
+#include <cctype>
+#include <string>
+#include <numeric>
+#include <iterator>
+#include <algorithm>
+
+namespace echoserver
+{
+
+namespace
+{
+
+/// @brief tells, whether character is a decimal digit
+/// @param character character to check
+/// @returns true if character is a digit, false - otherwise
+bool isDigit(char character)
+{
+    return std::isdigit(static_cast<unsigned char>(character)) != 0;
+}
+
+}
+
+//---------------------------------------------------------
+
+std::vector<int> extractNumbers(const char *begin, const char *end)
+{
+    ECHO_TRACE_SCOPE("extractNumbers");
+    std::vector<int> numbers;
+    const std::regex numberRegex("-?\\d+");
+    const auto numBegin = std::cregex_iterator(begin, end, numberRegex);
+    const auto numEnd = std::cregex_iterator();
+
+    for (std::cregex_iterator i = numBegin; i != numEnd; ++i)
+        numbers.emplace_back( std::stoi((*i).str()) );
+
+    return numbers;
+}
+
+std::vector<std::size_t> findChunkBoundaries(const std::string &message, std::size_t chunkCount)
+{
+    std::vector<std::size_t> boundaries(1, 0);
+    const auto chunkSize = message.size() / std::max<std::size_t>(chunkCount, 1);
+
+    for (std::size_t i = 1; i < chunkCount && chunkSize > 0; ++i)
+    {
+        // moving boundary forward until it no longer cuts a number or separates it from its minus sign
+        auto boundary = std::max(i * chunkSize, boundaries.back());
+        while (boundary < message.size() && isDigit(message[boundary]) &&
+               (isDigit(message[boundary - 1]) || message[boundary - 1] == '-'))
+        {
+            ++boundary;
+        }
+
+        if (boundary > boundaries.back() && boundary < message.size())
+            boundaries.push_back(boundary);
+    }
+
+    boundaries.push_back(message.size());
+    return boundaries;
+}
+
+void collectNumbers(const std::string &message, WorkerPool *pool, std::vector<int> &numbers, int &sum)
+{
+    const auto descending = [](int lhs, int rhs){ return rhs < lhs; };
+
+    // pool busy with another message - this one is processed alone rather than adding threads
+    if (pool == nullptr || !pool->tryAcquire())
+    {
+        numbers = extractNumbers(message.data(), message.data() + message.size());
+
+        ECHO_TRACE_BEGIN(sortTrace);
+        std::sort(numbers.begin(), numbers.end(), descending);
+        ECHO_TRACE_END(sortTrace, "sort");
+
+        sum = std::accumulate(numbers.cbegin(), numbers.cend(), 0);
+        return;
+    }
+
+    // scanning, sorting and summing every part in its own pool thread
+    ECHO_TRACE_BEGIN(scanTrace);
+    const auto boundaries = findChunkBoundaries(message, pool->threadCount());
+    const auto chunkCount = boundaries.size() - 1;
+    std::vector<std::vector<int>> runs(chunkCount);
+    std::vector<int> sums(chunkCount, 0);
+    pool->run(chunkCount, [&](std::size_t chunk)
+    {
+        auto &run = runs[chunk];
+        run = extractNumbers(message.data() + boundaries[chunk], message.data() + boundaries[chunk + 1]);
+        std::sort(run.begin(), run.end(), descending);
+        sums[chunk] = std::accumulate(run.cbegin(), run.cend(), 0);
+    });
+    ECHO_TRACE_END(scanTrace, "parallel.scan");
+
+    // merging sorted parts pairwise, every round halves their number
+    ECHO_TRACE_BEGIN(mergeTrace);
+    while (runs.size() > 1)
+    {
+        std::vector<std::vector<int>> merged((runs.size() + 1) / 2);
+        pool->run(runs.size() / 2, [&](std::size_t pair)
+        {
+            const auto &lhs = runs[2 * pair];
+            const auto &rhs = runs[2 * pair + 1];
+            merged[pair].reserve(lhs.size() + rhs.size());
+            std::merge(lhs.cbegin(), lhs.cend(), rhs.cbegin(), rhs.cend(), std::back_inserter(merged[pair]), descending);
+        });
+        if (runs.size() % 2 != 0)
+            merged.back() = std::move(runs.back());
+        runs.swap(merged);
+    }
+    ECHO_TRACE_END(mergeTrace, "parallel.merge");
+    pool->release();
+
+    numbers = std::move(runs.front());
+    sum = std::accumulate(sums.cbegin(), sums.cend(), 0);
+}
+
+}
@@ -0,0 +1,37 @@
+#ifndef INCLUDE_ONCE_3B6F08D4_C17E_4A29_95D2_E84A6C0F13B7
+#define INCLUDE_ONCE_3B6F08D4_C17E_4A29_95D2_E84A6C0F13B7
+
+#include "workerpool.h"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace echoserver
+{
+
+/// @brief finds all decimal integers ("-?\d+") within a part of a message
+/// @param begin beginning of the text
+/// @param end end of the text
+/// @returns numbers in order of their appearance
+std::vector<int> extractNumbers(const char *begin, const char *end);
+
+/// @brief splits message into parts that can be scanned for numbers independently: a part never starts
+///        with a digit that continues a number ("12|34") or follows its minus sign ("-|5")
+/// @param message text of the message
+/// @param chunkCount desired number of parts
+/// @returns offsets where parts begin followed by message size, at most chunkCount + 1 of them
+std::vector<std::size_t> findChunkBoundaries(const std::string &message, std::size_t chunkCount);
+
+/// @brief collects numbers of a message sorted in descending order together with their sum; if the pool can be
+///        leased, the message is split by findChunkBoundaries() into a part per pool thread, every part is scanned,
+///        sorted and summed by the pool, then sorted parts are merged pairwise by the pool as well
+/// @param message text of the message
+/// @param pool pool to lease, nullptr or a busy pool - everything is done in the calling thread
+/// @param numbers vector to store numbers to
+/// @param sum variable to store sum of numbers to
+void collectNumbers(const std::string &message, WorkerPool *pool, std::vector<int> &numbers, int &sum);
+
+}
+
+#endif // include guard
@@ -0,0 +1,124 @@
+#include "numberformatter.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+
+namespace echoserver
+{
+
+namespace
+{
+
+/// text of every number 00 - 99, two characters each
+const char digitPairs[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+/// @brief counts decimal digits of a number
+/// @param value number
+/// @returns number of digits, at least 1
+std::size_t countDigits(uint32_t value)
+{
+    std::size_t digits = 1;
+    while (true)
+    {
+        if (value < 10) return digits;
+        if (value < 100) return digits + 1;
+        if (value < 1000) return digits + 2;
+        if (value < 10000) return digits + 3;
+        value /= 10000;
+        digits += 4;
+    }
+}
+
+}
+
+std::size_t formatInt(int value, char *out)
+{
+    char *cursor = out;
+    // negating in unsigned arithmetic, so INT_MIN doesn't overflow
+    uint32_t magnitude = static_cast<uint32_t>(value);
+    if (value < 0)
+    {
+        *cursor++ = '-';
+        magnitude = 0u - magnitude;
+    }
+
+    char *const end = cursor + countDigits(magnitude);
+    cursor = end;
+    while (magnitude >= 100)
+    {
+        const auto pair = (magnitude % 100) * 2;
+        magnitude /= 100;
+        *--cursor = digitPairs[pair + 1];
+        *--cursor = digitPairs[pair];
+    }
+    if (magnitude >= 10)
+    {
+        *--cursor = digitPairs[magnitude * 2 + 1];
+        *--cursor = digitPairs[magnitude * 2];
+    }
+    else
+    {
+        *--cursor = static_cast<char>('0' + magnitude);
+    }
+
+    return end - out;
+}
+
+//---------------------------------------------------------
+
+void NumberFormatter::reserve(std::size_t extraSize)
+{
+    if (size_ + extraSize <= capacity_)
+        return;
+
+    const auto newCapacity = std::max(size_ + extraSize, capacity_ * 2);
+    std::unique_ptr<char[]> newBuffer(new char [newCapacity]);
+    if (size_ > 0)
+        std::memcpy(newBuffer.get(), buffer_.get(), size_);
+    buffer_ = std::move(newBuffer);
+    capacity_ = newCapacity;
+}
+
+void NumberFormatter::append(const std::string &text)
+{
+    reserve(text.size());
+    std::memcpy(buffer_.get() + size_, text.data(), text.size());
+    size_ += text.size();
+}
+
+void NumberFormatter::append(int value)
+{
+    reserve(maxIntTextLength);
+    size_ += formatInt(value, buffer_.get() + size_);
+}
+
+void NumberFormatter::appendList(const std::vector<int> &numbers)
+{
+    if (numbers.empty())
+        return;
+
+    // every number takes at most maxIntTextLength characters plus a separator
+    reserve(numbers.size() * (maxIntTextLength + 1));
+    char *cursor = buffer_.get() + size_;
+    cursor += formatInt(numbers.front(), cursor);
+    for (auto it = std::next(numbers.cbegin()); it != numbers.cend(); ++it)
+    {
+        *cursor++ = ' ';
+        cursor += formatInt(*it, cursor);
+    }
+    size_ = cursor - buffer_.get();
+}
+
+}
@@ -0,0 +1,55 @@
+#ifndef INCLUDE_ONCE_9B4E1D63_27AF_4C8E_B5D0_E8F6A3C19274
+#define INCLUDE_ONCE_9B4E1D63_27AF_4C8E_B5D0_E8F6A3C19274
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+namespace echoserver
+{
+
+constexpr std::size_t maxIntTextLength = 11;    /// < length of the longest int as text, "-2147483648"
+
+/// @brief writes int as decimal text, two digits per step using a digit-pair table
+/// @param value number to write
+/// @param out buffer with at least maxIntTextLength free characters
+/// @returns number of characters written
+std::size_t formatInt(int value, char *out);
+
+/// @brief builds text into a single buffer that grows only when it has to, so one formatter
+///        reused for many messages stops allocating once it has seen the largest one
+class NumberFormatter
+{
+public:
+    /// @brief makes sure at least extraSize more characters fit without reallocation
+    /// @param extraSize number of characters about to be appended
+    void reserve(std::size_t extraSize);
+    /// @brief appends text
+    /// @param text text to append
+    void append(const std::string &text);
+    /// @brief appends number as decimal text
+    /// @param value number to append
+    void append(int value);
+    /// @brief appends numbers as decimal text separated by single spaces; space for all of them is reserved up front
+    /// @param numbers numbers to append
+    void appendList(const std::vector<int> &numbers);
+    /// @brief forgets formatted text, keeping the buffer
+    void clear() { size_ = 0; }
+
+    /// @brief gives formatted text
+    /// @returns pointer to the first character, text is not null-terminated
+    const char *data() const { return buffer_.get(); }
+    /// @brief tells length of formatted text
+    /// @returns number of characters
+    std::size_t size() const { return size_; }
+
+private:
+    std::unique_ptr<char[]> buffer_;    /// < formatted text
+    std::size_t capacity_ = 0;          /// < size of the buffer
+    std::size_t size_ = 0;              /// < length of formatted text
+};
+
+}
+
+#endif // include guard
@@ -0,0 +1,49 @@
+#ifndef INCLUDE_ONCE_7D0E3C52_91A4_4F1B_B6E8_2C5A0F4D9B17
+#define INCLUDE_ONCE_7D0E3C52_91A4_4F1B_B6E8_2C5A0F4D9B17
+
+#include "globals.h"
+#include "threadplacement.h"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace echoserver
+{
+
+/// @brief optional startup settings of the EchoServer
+struct ServerOptions
+{
+    uint16_t port = 0;                                  /// < port to which the EchoServer will be listening to
+    uint32_t bufferSize = globals::defaultBufferSize;   /// < size of the read buffers
+
+    bool udpGro = false;                /// < enables UDP_GRO on receive and UDP_SEGMENT (GSO) on transmit for the UDP listener
+
+    int tcpListenerCpu = anyCpu;        /// < core the TCP listener (accepting) thread is pinned to
+    int udpListenerCpu = anyCpu;        /// < core the UDP listener thread is pinned to
+    std::vector<int> workerCpus;        /// < cores TCP connection and worker pool threads are pinned to in round-robin order
+    int tcpEventWorkers = 0;            /// < number of epoll event loop threads serving TCP clients, 0 - thread per connection
+    int busyPollMicroseconds = 0;       /// < SO_BUSY_POLL value for the UDP socket, 0 - disabled
+    int spinMicroseconds = 0;           /// < how long UDP listener spins on non-blocking reads before blocking
+
+    std::size_t parallelThreshold = 0;  /// < messages of at least this size are processed by parallelThreads threads, 0 - never
+    std::size_t parallelThreads = 0;    /// < size of the server-wide pool large messages are processed by, 0 - one per worker cpu or core
+
+    std::string traceFile;              /// < file trace points are dumped to on SIGUSR1 (needs ECHOSERVER_TRACING build)
+    std::string captureFile;            /// < file received messages are appended to for replay, empty - capture disabled
+
+    int drainTimeoutMs = 5000;          /// < how long stopping server keeps processing received messages and serving connected clients
+    int inheritedTcpDescriptor = -1;    /// < listening TCP socket handed over by the previous server process, -1 - none
+    int inheritedUdpDescriptor = -1;    /// < bound UDP socket handed over by the previous server process, -1 - none
+    int readyDescriptor = -1;           /// < socket the successor tells the previous server process it is serving through, -1 - none
+    std::string executablePath;         /// < server binary resolved at startup, so a binary replaced on disk is picked up on reload
+    std::vector<std::string> commandLine;   /// < arguments the server was started with, reused to start its successor
+};
+
+const std::string inheritSocketsOption = "--inherit-sockets";   /// < passes socket descriptors to the successor process:
+                                                                ///   "<tcp socket>,<udp socket>,<readiness socket>"
+
+}
+
+#endif // include guard
@@ -0,0 +1,79 @@
+#include "threadplacement.h"
+
+#include <cctype>
+#include <cerrno>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sched.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+namespace echoserver
+{
+
+bool pinCurrentThread(int cpu)
+{
+    if (cpu == anyCpu)
+        return true;
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+
+    const auto result = pthread_setaffinity_np(pthread_self(), sizeof cpuSet, &cpuSet);
+    if (result != 0)
+    {
+        std::cerr << "WARNING: failed to pin thread to cpu " << cpu << " (" << std::strerror(result) << ").\n";
+        return false;
+    }
+
+    return true;
+}
+
+int numaNodeOfCpu(int cpu)
+{
+    // every cpu directory in sysfs contains a 'nodeN' link to the node the cpu belongs to
+    const std::string cpuDirectory = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR *directory = opendir(cpuDirectory.c_str());
+    if (directory == nullptr)
+        return unknownNumaNode;
+
+    auto node = unknownNumaNode;
+    while (dirent *entry = readdir(directory))
+    {
+        if (std::strncmp(entry->d_name, "node", 4) == 0 && std::isdigit(entry->d_name[4]))
+        {
+            node = std::atoi(entry->d_name + 4);
+            break;
+        }
+    }
+
+    closedir(directory);
+    return node;
+}
+
+char *allocateLocalBuffer(std::size_t size)
+{
+    // heap allocator may hand out memory another thread already touched on another node,
+    // an anonymous mapping always starts with untouched pages
+    void *buffer = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED)
+    {
+        std::cerr << "ERROR: failed to allocate " << size << " bytes read buffer (" << std::strerror(errno) << ")!\n";
+        return nullptr;
+    }
+
+    std::memset(buffer, 0x00, size);
+    return static_cast<char*>(buffer);
+}
+
+void releaseLocalBuffer(char *buffer, std::size_t size)
+{
+    if (buffer != nullptr)
+        munmap(buffer, size);
+}
+
+}
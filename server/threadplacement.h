@@ -0,0 +1,35 @@
+#ifndef INCLUDE_ONCE_C84F2E19_6B3D_4A70_8F25_D19E7A0B3C64
+#define INCLUDE_ONCE_C84F2E19_6B3D_4A70_8F25_D19E7A0B3C64
+
+#include <cstddef>
+
+namespace echoserver
+{
+
+constexpr auto anyCpu = -1;          /// < thread is not pinned and may run on any core
+constexpr auto unknownNumaNode = -1; /// < NUMA node of the core couldn't be determined
+
+/// @brief pins calling thread to a single core
+/// @param cpu index of the core, anyCpu leaves the thread's affinity untouched
+/// @returns true if thread was pinned (or no pinning was requested), false - otherwise
+bool pinCurrentThread(int cpu);
+
+/// @brief tells, which NUMA node a core belongs to
+/// @param cpu index of the core
+/// @returns NUMA node index or unknownNumaNode
+int numaNodeOfCpu(int cpu);
+
+/// @brief maps fresh anonymous pages for a buffer and touches all of them from the calling thread, so with
+///        default (first-touch) memory policy pages are placed on NUMA node of the core the thread is pinned to
+/// @param size size of the buffer
+/// @returns buffer that must be released with releaseLocalBuffer(), nullptr if memory couldn't be mapped
+char *allocateLocalBuffer(std::size_t size);
+
+/// @brief releases buffer allocated by allocateLocalBuffer()
+/// @param buffer buffer to release, nullptr is ignored
+/// @param size size the buffer was allocated with
+void releaseLocalBuffer(char *buffer, std::size_t size);
+
+}
+
+#endif // include guard
@@ -0,0 +1,227 @@
+#include "tracing.h"
+
+#ifdef ECHOSERVER_TRACING
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace echoserver
+{
+namespace tracing
+{
+
+namespace
+{
+
+constexpr auto eventsPerBlock = 1024;                   /// < ring buffers grow by blocks of this many events
+constexpr auto blocksPerThread = eventsPerThread / eventsPerBlock;  /// < most blocks a single ring buffer may have
+constexpr std::size_t maxTracedEvents = 1024 * 1024;    /// < most events all ring buffers together may hold
+
+/// @brief finished stage; fields are atomic, so dump() may read a slot its owner is overwriting
+struct Event
+{
+    std::atomic<const char*> name;      /// < stage name
+    std::atomic<uint64_t> begin;        /// < stage start timestamp
+    std::atomic<uint64_t> end;          /// < stage end timestamp
+    std::atomic<long> threadId;         /// < kernel thread id, shown as 'tid' in the trace
+};
+
+/// @brief ring buffer of events; written only by the thread that owns it, without locks,
+///        and handed over to another thread once the owner exits
+struct ThreadBuffer
+{
+    std::atomic<Event*> blocks[blocksPerThread];    /// < lazily allocated storage, nullptr - not allocated yet
+    std::atomic<uint64_t> capacity;                 /// < number of events in allocated blocks
+    std::atomic<uint64_t> recorded;                 /// < total number of events recorded, next slot is recorded % capacity
+    bool growthStopped = false;                     /// < true once buffer can't get more blocks and starts overwriting
+    long threadId = 0;                              /// < kernel thread id of the current owner
+
+    ThreadBuffer() : capacity(0), recorded(0)
+    {
+        for (auto &block : blocks)
+            block.store(nullptr, std::memory_order_relaxed);
+    }
+};
+
+std::atomic<std::size_t> allocatedEvents(0);    /// < events in blocks of all ring buffers
+
+/// @brief buffers of all threads that ever recorded an event and buffers of exited threads ready for reuse;
+///        never destroyed, so detached threads may still record while the process exits
+struct Registry
+{
+    std::mutex mutex;                           /// < guards both lists, taken only on thread start / exit and by dump()
+    std::vector<ThreadBuffer*> buffers;         /// < all buffers
+    std::vector<ThreadBuffer*> freeBuffers;     /// < buffers whose owner thread has exited
+};
+
+Registry &registry()
+{
+    static Registry *instance = new Registry;
+    return *instance;
+}
+
+/// @brief gives calling thread's buffer back to the registry when the thread exits
+struct BufferOwner
+{
+    ThreadBuffer *buffer = nullptr;     /// < buffer owned by the thread
+
+    ~BufferOwner()
+    {
+        if (buffer == nullptr)
+            return;
+        auto &instance = registry();
+        std::lock_guard<std::mutex> lock(instance.mutex);
+        instance.freeBuffers.push_back(buffer);
+    }
+};
+
+/// @brief gets calling thread's buffer; the first call takes over a buffer of an exited thread or registers a new one
+/// @returns thread's buffer
+ThreadBuffer &threadBuffer()
+{
+    thread_local BufferOwner owner;
+    if (owner.buffer == nullptr)
+    {
+        auto &instance = registry();
+        std::lock_guard<std::mutex> lock(instance.mutex);
+        if (!instance.freeBuffers.empty())
+        {
+            owner.buffer = instance.freeBuffers.back();
+            instance.freeBuffers.pop_back();
+        }
+        else
+        {
+            owner.buffer = new ThreadBuffer;
+            instance.buffers.push_back(owner.buffer);
+        }
+        owner.buffer->threadId = syscall(SYS_gettid);
+    }
+    return *owner.buffer;
+}
+
+/// @brief adds a block to a full buffer unless it reached its own or the global limit
+/// @param buffer buffer to grow, owned by the calling thread
+void growBuffer(ThreadBuffer &buffer)
+{
+    const auto capacity = buffer.capacity.load(std::memory_order_relaxed);
+    const auto blockIndex = capacity / eventsPerBlock;
+    if (blockIndex >= static_cast<uint64_t>(blocksPerThread) ||
+        allocatedEvents.fetch_add(eventsPerBlock) + eventsPerBlock > maxTracedEvents)
+    {
+        if (blockIndex < static_cast<uint64_t>(blocksPerThread))
+            allocatedEvents.fetch_sub(eventsPerBlock);
+        buffer.growthStopped = true;
+        return;
+    }
+
+    buffer.blocks[blockIndex].store(new Event[eventsPerBlock](), std::memory_order_release);
+    buffer.capacity.store(capacity + eventsPerBlock, std::memory_order_release);
+}
+
+/// @brief finds slot of an event
+/// @param buffer buffer holding the event
+/// @param index index of the slot within allocated blocks
+/// @returns slot, nullptr if its block isn't visible yet
+Event *eventSlot(ThreadBuffer &buffer, uint64_t index)
+{
+    Event *block = buffer.blocks[index / eventsPerBlock].load(std::memory_order_acquire);
+    return block != nullptr ? block + index % eventsPerBlock : nullptr;
+}
+
+}
+
+uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(const char *name, uint64_t begin, uint64_t end)
+{
+    auto &buffer = threadBuffer();
+    const auto index = buffer.recorded.load(std::memory_order_relaxed);
+    // capacity only grows while nothing was overwritten yet, so index % capacity stays valid for older events
+    if (index == buffer.capacity.load(std::memory_order_relaxed) && !buffer.growthStopped)
+        growBuffer(buffer);
+
+    const auto capacity = buffer.capacity.load(std::memory_order_relaxed);
+    if (capacity == 0)
+        return;
+
+    // pairs with the acquire fence in dump(): a reader that sees this slot's new fields also sees recorded >= index
+    std::atomic_thread_fence(std::memory_order_release);
+    auto &event = *eventSlot(buffer, index % capacity);
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    event.threadId.store(buffer.threadId, std::memory_order_relaxed);
+    buffer.recorded.store(index + 1, std::memory_order_release);
+}
+
+bool dump(const std::string &path)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+        return false;
+
+    std::vector<ThreadBuffer*> buffers;
+    {
+        auto &instance = registry();
+        std::lock_guard<std::mutex> lock(instance.mutex);
+        buffers = instance.buffers;
+    }
+
+    const auto processId = getpid();
+    file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    auto first = true;
+    for (const auto buffer : buffers)
+    {
+        // owners keep recording without locks: slots are copied first, then events the owner may have
+        // overwritten meanwhile are dropped
+        const auto recorded = buffer->recorded.load(std::memory_order_acquire);
+        const auto capacity = buffer->capacity.load(std::memory_order_acquire);
+        const auto count = std::min(recorded, capacity);
+
+        struct Copy { const char *name; uint64_t begin; uint64_t end; long threadId; uint64_t index; };
+        std::vector<Copy> events;
+        events.reserve(count);
+        for (auto i = recorded - count; i < recorded; ++i)
+        {
+            const Event *event = eventSlot(*buffer, i % capacity);
+            if (event == nullptr)
+                continue;
+            events.push_back(Copy{ event->name.load(std::memory_order_relaxed), event->begin.load(std::memory_order_relaxed),
+                                   event->end.load(std::memory_order_relaxed),
+                                   event->threadId.load(std::memory_order_relaxed), i });
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const auto recordedAfterCopy = buffer->recorded.load(std::memory_order_relaxed);
+
+        for (const auto &event : events)
+        {
+            if (event.index + capacity <= recordedAfterCopy)
+                continue;
+
+            // complete ("X") events, timestamps in microseconds
+            file << (first ? "\n" : ",\n")
+                 << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":" << processId
+                 << ",\"tid\":" << event.threadId << ",\"ts\":" << event.begin / 1000.0
+                 << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+            first = false;
+        }
+    }
+    file << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+    return static_cast<bool>(file);
+}
+
+}
+}
+
+#endif // ECHOSERVER_TRACING
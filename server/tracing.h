@@ -0,0 +1,74 @@
+#ifndef INCLUDE_ONCE_E2B7A94D_0F6C_4C35_A1D8_73F95B2E6C01
+#define INCLUDE_ONCE_E2B7A94D_0F6C_4C35_A1D8_73F95B2E6C01
+
+// Hot-path trace points. Built only when ECHOSERVER_TRACING is defined (cmake -DECHOSERVER_TRACING=ON),
+// otherwise every macro below expands to nothing.
+
+#ifdef ECHOSERVER_TRACING
+
+#include <string>
+#include <cstdint>
+
+namespace echoserver
+{
+namespace tracing
+{
+
+constexpr auto eventsPerThread = 64 * 1024;     /// < largest capacity of a thread's ring buffer, oldest events are overwritten;
+                                                ///   buffers start small, grow on demand and are reused after their thread exits
+
+/// @brief reads trace clock
+/// @returns nanoseconds of std::chrono::steady_clock
+uint64_t now();
+
+/// @brief stores a finished stage into calling thread's ring buffer, takes no locks except on the thread's first event
+/// @param name stage name, must be a string literal
+/// @param begin stage start timestamp
+/// @param end stage end timestamp
+void record(const char *name, uint64_t begin, uint64_t end);
+
+/// @brief writes events of all threads into a Chrome trace / Perfetto JSON file
+/// @param path path of the file
+/// @returns true if file was written, false - otherwise
+bool dump(const std::string &path);
+
+/// @brief records a stage that lasts until the end of the enclosing block
+class Scope
+{
+public:
+    /// @brief Scope class constructor
+    /// @param name stage name, must be a string literal
+    explicit Scope(const char *name) : name_(name), begin_(now()) {}
+    /// @brief Scope class destructor
+    ~Scope() { record(name_, begin_, now()); }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    const char *name_;  /// < stage name
+    uint64_t begin_;    /// < stage start timestamp
+};
+
+}
+}
+
+#define ECHO_TRACE_CONCAT_IMPL(a, b) a##b
+#define ECHO_TRACE_CONCAT(a, b) ECHO_TRACE_CONCAT_IMPL(a, b)
+
+/// traces the rest of the enclosing block as stage 'name'
+#define ECHO_TRACE_SCOPE(name) ::echoserver::tracing::Scope ECHO_TRACE_CONCAT(echoTraceScope_, __LINE__)(name)
+/// starts stage 'var' that is finished by ECHO_TRACE_END(var, name) in the same block
+#define ECHO_TRACE_BEGIN(var) const auto var = ::echoserver::tracing::now()
+/// finishes stage started by ECHO_TRACE_BEGIN(var)
+#define ECHO_TRACE_END(var, name) ::echoserver::tracing::record(name, var, ::echoserver::tracing::now())
+
+#else
+
+#define ECHO_TRACE_SCOPE(name) static_cast<void>(0)
+#define ECHO_TRACE_BEGIN(var) static_cast<void>(0)
+#define ECHO_TRACE_END(var, name) static_cast<void>(0)
+
+#endif // ECHOSERVER_TRACING
+
+#endif // include guard
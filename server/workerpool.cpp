@@ -0,0 +1,99 @@
+#include "workerpool.h"
+#include "threadplacement.h"
+
+#include <signal.h>
+#include <pthread.h>
+
+namespace echoserver
+{
+
+WorkerPool::WorkerPool(std::size_t threadCount, const std::vector<int> &cpus)
+    : leased_(false)
+{
+    for (std::size_t i = 1; i < threadCount; ++i)
+        workers_.emplace_back(&WorkerPool::runWorker, this, cpus.empty() ? anyCpu : cpus[(i - 1) % cpus.size()]);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex_);
+        stopping_ = true;
+    }
+    tasksReady_.notify_all();
+
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+//---------------------------------------------------------
+
+bool WorkerPool::tryAcquire()
+{
+    return !workers_.empty() && !leased_.exchange(true, std::memory_order_acquire);
+}
+
+void WorkerPool::release()
+{
+    leased_.store(false, std::memory_order_release);
+}
+
+void WorkerPool::run(std::size_t count, const std::function<void(std::size_t)> &task)
+{
+    std::unique_lock<std::mutex> lock(tasksMutex_);
+    task_ = &task;
+    taskCount_ = count;
+    nextTask_ = 0;
+    doneTasks_ = 0;
+    tasksReady_.notify_all();
+
+    // calling thread takes tasks too instead of waiting idle
+    runTasks(lock);
+    tasksDone_.wait(lock, [this]() { return doneTasks_ == taskCount_; });
+    task_ = nullptr;
+}
+
+//---------------------------------------------------------
+
+void WorkerPool::runTasks(std::unique_lock<std::mutex> &lock)
+{
+    // a task is taken and finished under the lock, so the set can't be replaced while one of its tasks runs
+    while (task_ != nullptr && nextTask_ < taskCount_)
+    {
+        const auto &task = *task_;
+        const auto index = nextTask_++;
+
+        lock.unlock();
+        task(index);
+        lock.lock();
+
+        if (++doneTasks_ == taskCount_)
+            tasksDone_.notify_all();
+    }
+}
+
+void WorkerPool::runWorker(int cpu)
+{
+    // pool is created before the server blocks signals, signals it waits for must reach the server's signal thread;
+    // fault signals stay unblocked, so a crash in a task isn't turned into a hang
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    pinCurrentThread(cpu);
+
+    std::unique_lock<std::mutex> lock(tasksMutex_);
+    while (true)
+    {
+        tasksReady_.wait(lock, [this]() { return stopping_ || (task_ != nullptr && nextTask_ < taskCount_); });
+        if (stopping_)
+            return;
+
+        runTasks(lock);
+    }
+}
+
+}
@@ -0,0 +1,65 @@
+#ifndef INCLUDE_ONCE_DE46E2DA_26B9_404C_B7E5_E84A2F059EE4
+#define INCLUDE_ONCE_DE46E2DA_26B9_404C_B7E5_E84A2F059EE4
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+
+namespace echoserver
+{
+
+/// @brief fixed set of threads shared by the whole server for processing large messages in parallel;
+///        one caller at a time leases the pool, the others find it busy and do their work alone,
+///        so the number of processing threads never exceeds the pool size however many messages arrive
+class WorkerPool
+{
+public:
+    /// @brief WorkerPool class constructor, starts threadCount - 1 threads, the leasing thread is the last one
+    /// @param threadCount number of threads a task set is run by, including the calling thread
+    /// @param cpus cores the threads are pinned to in round-robin order, empty - threads are not pinned
+    explicit WorkerPool(std::size_t threadCount, const std::vector<int> &cpus = std::vector<int>());
+    /// @brief WorkerPool class destructor, stops and joins the threads; the pool must not be leased
+    ~WorkerPool();
+
+    /// @brief tells, how many threads run a task set, including the calling thread
+    /// @returns number of threads
+    std::size_t threadCount() const { return workers_.size() + 1; }
+    /// @brief leases the pool to the calling thread unless another thread holds it, never waits
+    /// @returns true if the pool was leased, false - if it is busy
+    bool tryAcquire();
+    /// @brief returns the pool leased by tryAcquire()
+    void release();
+    /// @brief runs task for every index from 0 to count - 1 on the pool's threads and the calling thread,
+    ///        returns once all of them are done; only the thread that leased the pool may call it
+    /// @param count number of tasks
+    /// @param task function taking task index
+    void run(std::size_t count, const std::function<void(std::size_t)> &task);
+
+private:
+    /// @brief takes tasks of the current task set until the pool is destroyed
+    /// @param cpu core the thread is pinned to or anyCpu
+    void runWorker(int cpu);
+    /// @brief runs tasks of the current task set until none is left
+    /// @param lock held lock of tasksMutex_, released while a task runs
+    void runTasks(std::unique_lock<std::mutex> &lock);
+
+    std::vector<std::thread> workers_;                       /// < pool's threads
+    std::atomic<bool> leased_;                               /// < true while a thread holds the pool
+
+    std::mutex tasksMutex_;                                  /// < guards the task set and stopping_
+    std::condition_variable tasksReady_;                     /// < notified when a task set is published or pool stops
+    std::condition_variable tasksDone_;                      /// < notified when the last task of a set is done
+    const std::function<void(std::size_t)> *task_ = nullptr; /// < function of the current task set, nullptr - none
+    std::size_t taskCount_ = 0;                              /// < number of tasks in the current set
+    std::size_t nextTask_ = 0;                               /// < index of the first task nobody took yet
+    std::size_t doneTasks_ = 0;                              /// < number of finished tasks of the current set
+    bool stopping_ = false;                                  /// < true once the pool is being destroyed
+};
+
+}
+
+#endif // include guard